@@ -0,0 +1,80 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#ifndef CellVisibilityHPP
+#define CellVisibilityHPP
+
+#include <cstdint>
+#include <vector>
+
+namespace io {
+  /**
+   * The set of cells of a map that can be seen from one place.  Stored both
+   * as a bitmap, for quick lookups, and as a list of cell indices
+   * (y * width + x), for quick iteration.
+   */
+  class CellVisibility {
+  public:
+    CellVisibility(const int32_t width, const int32_t height)
+      : width(width), height(height), visible(width * height, false) {
+    }
+
+    void clear() {
+      for (uint32_t cell : cells) {
+        visible[cell] = false;
+      }
+      cells.clear();
+    }
+
+    const std::vector<uint32_t>& getVisibleCells() const {
+      return cells;
+    }
+
+    int32_t getHeight() const {
+      return height;
+    }
+
+    int32_t getWidth() const {
+      return width;
+    }
+
+    bool isVisible(const int32_t x, const int32_t y) const {
+      if (x < 0 || y < 0 || x >= width || y >= height) {
+        return false;
+      }
+
+      return visible[(y * width) + x];
+    }
+
+    void markVisible(const int32_t x, const int32_t y) {
+      if (x < 0 || y < 0 || x >= width || y >= height) {
+        return;
+      }
+
+      uint32_t cell = (y * width) + x;
+      if (!visible[cell]) {
+        visible[cell] = true;
+        cells.push_back(cell);
+      }
+    }
+  private:
+    int32_t width;
+    int32_t height;
+    std::vector<bool> visible;
+    std::vector<uint32_t> cells;
+  };
+}
+
+#endif // CellVisibilityHPP
@@ -23,7 +23,7 @@
 namespace io {
   class Component {
   public:
-    Component() {}
+    Component() : dirty(true) {}
     virtual ~Component() {}
     
     void draw(Graphics* g);
@@ -56,8 +56,24 @@ namespace io {
       return false;
     }
 
+    //  Whenever a component would look different, it has to call this, so
+    //  that a cached screen knows to draw it again.
+    void invalidate() {
+      dirty = true;
+    }
+
+    virtual bool isDirty() const {
+      return dirty;
+    }
+
+    //  Called once the screen holding the component has been redrawn.
+    virtual void markClean() {
+      dirty = false;
+    }
+
     void setPosition(const Point& position) {
       this->position = position;
+      invalidate();
     }
     
     void setPosition(const float x, const float y) {
@@ -66,12 +82,14 @@ namespace io {
     
     void setSize(const Dimension& size) {
       this->size = size;
+      invalidate();
     }
     
     void setSize(const float width, const float height) {
       setSize(Dimension(width, height));
     }
   private:
+    bool dirty;
     Point position;
     Dimension size;
     
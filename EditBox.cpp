@@ -19,14 +19,14 @@
 namespace io {
   EditBox::EditBox() {
     ResourceManager* rm = ResourceManager::getInstance();
-    font = rm->getResource("data/DejaVuSansMono.ttf")->toFont();
+    layout.setFont(rm->getResource("data/DejaVuSansMono.ttf")->toFont());
     maxLength = UINT32_MAX;
   }
 
   void EditBox::render(Graphics* g) {
     Font* f = getFont();
     if (f) {
-      f->drawText(getText(), Colour(255,255,255,255));
+      layout.draw(g, Colour(255,255,255,255));
     }
   }
 }
@@ -21,6 +21,7 @@
 #include <list>
 #include "Component.hpp"
 #include "Font.hpp"
+#include "TextLayout.hpp"
 
 namespace io {
   class EditBox;
@@ -45,7 +46,7 @@ namespace io {
     }
 
     Font* getFont() const {
-      return font;
+      return layout.getFont();
     }
 
     uint32_t getMaxLength() const {
@@ -53,7 +54,7 @@ namespace io {
     }
 
     std::string getText() {
-      return text;
+      return layout.getText();
     }
 
     virtual bool handleInputEvent(const InputEvent& event) {
@@ -70,13 +71,15 @@ namespace io {
             c = event.getCharCode();
             if (c != 0 && c != '\t') {
               if (event.getCharCode() == 0x08) {
-                if (text.size() > 0) {
-                  text.resize(text.size() - 1);
+                if (layout.getText().size() > 0) {
+                  layout.truncate(layout.getText().size() - 1);
+                  invalidate();
                 }
               }
               else {
-                if (text.size() < getMaxLength()) {
-                  text.push_back(event.getCharCode());
+                if (layout.getText().size() < getMaxLength()) {
+                  layout.append(std::string(1, c));
+                  invalidate();
                   textChanged();
                 }
               }
@@ -95,23 +98,23 @@ namespace io {
     }
 
     void setFont(Font* font) {
-      this->font = font;
+      layout.setFont(font);
+      invalidate();
     }
 
     void setMaxLength(const uint32_t maxLength) {
       this->maxLength = maxLength;
-      if (text.size() > maxLength) {
-        text.resize(maxLength);
-      }
+      layout.truncate(maxLength);
+      invalidate();
     }
 
     void setText(const std::string& text) {
-      this->text = text;
+      layout.setText(text);
+      invalidate();
     }
   private:
-    Font* font;
     std::list<EditBoxActionListener*> listeners;
-    std::string text;
+    TextLayout layout;
     uint32_t maxLength;
 
     EditBox(const EditBox&);
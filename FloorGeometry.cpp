@@ -0,0 +1,175 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#include "FloorGeometry.hpp"
+#include <algorithm>
+
+namespace io {
+  FloorGeometry::FloorGeometry()
+    : centre(0.0f, 0.0f, 0.0f) {
+    built = false;
+    dirty = true;
+    currentCell = 0;
+    visibilityComputed = false;
+    ceilings = new Mesh();
+    floors = new Mesh();
+    walls = new Mesh();
+  }
+
+  FloorGeometry::~FloorGeometry() {
+    delete ceilings;
+    ceilings = nullptr;
+
+    delete floors;
+    floors = nullptr;
+
+    delete walls;
+    walls = nullptr;
+  }
+
+  void FloorGeometry::begin() {
+    built = false;
+    cellRanges.clear();
+    ceilings->begin(GL_TRIANGLES);
+    floors->begin(GL_TRIANGLES);
+    walls->begin(GL_TRIANGLES);
+  }
+
+  void FloorGeometry::end() {
+    bool first = true;
+    Vector3 min(0.0f, 0.0f, 0.0f);
+    Vector3 max(0.0f, 0.0f, 0.0f);
+    for (uint32_t i = 0; i < FloorGeometry::MESH_COUNT; i++) {
+      for (const Vertex& v : getMesh(i)->getVertices()) {
+        if (first) {
+          min = v.position;
+          max = v.position;
+          first = false;
+        }
+        else {
+          min = Vector3(std::min(min.getX(), v.position.getX()),
+                        std::min(min.getY(), v.position.getY()),
+                        std::min(min.getZ(), v.position.getZ()));
+          max = Vector3(std::max(max.getX(), v.position.getX()),
+                        std::max(max.getY(), v.position.getY()),
+                        std::max(max.getZ(), v.position.getZ()));
+        }
+      }
+    }
+    centre = (min + max) / 2.0f;
+
+    ceilings->end();
+    floors->end();
+    walls->end();
+    built = true;
+    dirty = false;
+  }
+
+  void FloorGeometry::beginCell(const uint32_t cell) {
+    if (cell >= cellRanges.size()) {
+      cellRanges.resize(cell + 1);
+    }
+
+    currentCell = cell;
+    for (uint32_t i = 0; i < FloorGeometry::MESH_COUNT; i++) {
+      cellRanges[cell].first[i] = getMesh(i)->getVertexCount();
+    }
+  }
+
+  void FloorGeometry::endCell() {
+    CellRange& range = cellRanges.at(currentCell);
+    for (uint32_t i = 0; i < FloorGeometry::MESH_COUNT; i++) {
+      range.count[i] = getMesh(i)->getVertexCount() - range.first[i];
+    }
+  }
+
+  void FloorGeometry::addCeilingTile(const Mesh* source, const Matrix& transform) {
+    appendMesh(ceilings, source, transform);
+  }
+
+  void FloorGeometry::addFloorTile(const Mesh* source, const Matrix& transform) {
+    appendMesh(floors, source, transform);
+  }
+
+  void FloorGeometry::addWallTile(const Mesh* source, const Matrix& transform) {
+    appendMesh(walls, source, transform);
+  }
+
+  void FloorGeometry::draw() const {
+    if (visibilityComputed) {
+      drawCells(visibleCells);
+    }
+    else if (isBuilt()) {
+      floors->draw();
+      ceilings->draw();
+      walls->draw();
+    }
+  }
+
+  void FloorGeometry::drawCells(const std::vector<uint32_t>& cells) const {
+    if (!isBuilt()) {
+      return;
+    }
+
+    for (uint32_t i = 0; i < FloorGeometry::MESH_COUNT; i++) {
+      firsts.clear();
+      counts.clear();
+
+      for (uint32_t cell : cells) {
+        if (cell >= cellRanges.size() || cellRanges[cell].count[i] == 0) {
+          continue;
+        }
+
+        const CellRange& range = cellRanges[cell];
+
+        //  Cells that were baked one after the other are drawn as one run.
+        if (firsts.size() > 0 && firsts.back() + counts.back() == range.first[i]) {
+          counts.back() += range.count[i];
+        }
+        else {
+          firsts.push_back(range.first[i]);
+          counts.push_back(range.count[i]);
+        }
+      }
+
+      getMesh(i)->drawRanges(firsts, counts);
+    }
+  }
+
+  void FloorGeometry::appendMesh(Mesh* target, const Mesh* source, const Matrix& transform) {
+    if (!source) {
+      return;
+    }
+
+    for (const Vertex& v : source->getVertices()) {
+      Vertex baked = v;
+      baked.position = v.position * transform;
+      target->addVertex(baked);
+    }
+  }
+
+  Mesh* FloorGeometry::getMesh(const uint32_t which) const {
+    switch (which) {
+    case 0:
+      return floors;
+    case 1:
+      return ceilings;
+    default:
+      break;
+    }
+
+    return walls;
+  }
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#ifndef FloorGeometryHPP
+#define FloorGeometryHPP
+
+#include <cstdint>
+#include <vector>
+#include "Mesh.hpp"
+#include "Matrix.hpp"
+
+namespace io {
+  /**
+   * Holds the static geometry of a region of a floor, baked into world space.
+   * Rather than drawing each tile with its own transform and draw call, the
+   * tile meshes are copied into a handful of large meshes once, and drawn
+   * with a single transform per frame.  A map keeps one of these for every
+   * chunk of cells, and marks it dirty when a cell inside it changes.
+   */
+  class FloorGeometry {
+  public:
+    FloorGeometry();
+    ~FloorGeometry();
+
+    void begin();
+    void end();
+
+    /**
+     * Everything added between beginCell() and endCell() is recorded as
+     * belonging to the given cell, so that drawCells() can draw it on its
+     * own.  Cell IDs are chosen by the caller, and should be small.
+     */
+    void beginCell(const uint32_t cell);
+    void endCell();
+
+    void addCeilingTile(const Mesh* source, const Matrix& transform);
+    void addFloorTile(const Mesh* source, const Matrix& transform);
+    void addWallTile(const Mesh* source, const Matrix& transform);
+
+    /**
+     * Draws the geometry.  Once visibility has been worked out, only the
+     * cells on the visible list are drawn, and an empty list draws nothing.
+     * Until then, everything is drawn.
+     */
+    void draw() const;
+    void drawCells(const std::vector<uint32_t>& cells) const;
+
+    void addVisibleCell(const uint32_t cell) {
+      visibleCells.push_back(cell);
+    }
+
+    //  Starts a new visible list, with nothing on it yet.
+    void clearVisibleCells() {
+      visibleCells.clear();
+      visibilityComputed = true;
+    }
+
+    uint32_t getVisibleCellCount() const {
+      return visibleCells.size();
+    }
+
+    //  The middle of the geometry's bounds, in world space.
+    const Vector3& getCentre() const {
+      return centre;
+    }
+
+    bool isBuilt() const {
+      return built;
+    }
+
+    bool isDirty() const {
+      return dirty;
+    }
+
+    void markDirty() {
+      dirty = true;
+    }
+  private:
+    FloorGeometry(const FloorGeometry&) = delete;
+    FloorGeometry& operator=(const FloorGeometry&) = delete;
+
+    const static uint32_t MESH_COUNT = 3;
+
+    //  Where each cell's vertices live in each of the meshes.
+    struct CellRange {
+      CellRange() {
+        for (uint32_t i = 0; i < FloorGeometry::MESH_COUNT; i++) {
+          first[i] = 0;
+          count[i] = 0;
+        }
+      }
+
+      GLint first[FloorGeometry::MESH_COUNT];
+      GLsizei count[FloorGeometry::MESH_COUNT];
+    };
+
+    bool built;
+    bool dirty;
+    Vector3 centre;
+    Mesh* ceilings;
+    Mesh* floors;
+    Mesh* walls;
+
+    uint32_t currentCell;
+    std::vector<CellRange> cellRanges;
+    std::vector<uint32_t> visibleCells;
+    bool visibilityComputed;
+
+    //  Scratch space for drawCells(), kept around to avoid reallocating it
+    //  every frame.
+    mutable std::vector<GLint> firsts;
+    mutable std::vector<GLsizei> counts;
+
+    static void appendMesh(Mesh* target, const Mesh* source, const Matrix& transform);
+
+    Mesh* getMesh(const uint32_t which) const;
+  };
+}
+
+#endif // FloorGeometryHPP
@@ -13,23 +13,36 @@
  *  See the License for the specific language governing permissions and
  *  limitations under the License.
 */
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
 #include <utility>
 #include <boost/filesystem.hpp>
 #include "Font.hpp"
+#include "Graphics.hpp"
 #include <ft2build.h>
 #include <iostream>
 #include "Utility.hpp"
 #include "Common.hpp"
+#include "Log.hpp"
 #include FT_FREETYPE_H
 
 using namespace boost::filesystem;
 
 namespace io {
-  Font::Font(FT_Library library, const std::string& filename) {
+  const char GLYPH_CACHE_MAGIC[4] = { 'I', 'O', 'G', 'C' };
+
+  Font::Font(FT_Library library, const std::string& filename, const FontRenderMode renderMode)
+    : atlas(renderMode == FontRenderMode::DISTANCE_FIELD) {
     this->library = library;
+    this->renderMode = renderMode;
     activeGlyphSet = nullptr;
     face = nullptr;
-    mesh = new Mesh();
+    retiredFrame = 0;
+    fontHash = 0;
     pixelSize = 0;
 
     loadFont(filename);
@@ -37,157 +50,637 @@ namespace io {
   }
   
   Font::~Font() {
+    for (const std::pair<const std::pair<std::string, uint32_t>, CachedText>& cached : textCache) {
+      for (const std::pair<const uint32_t, Mesh*>& mesh : cached.second.meshes) {
+        delete mesh.second;
+      }
+    }
+    freeRetiredMeshes();
+
     if (face) {
       FT_Done_Face(face);
     }
 
-    for (std::pair<uint32_t, GlyphSet*> glyphSet : glyphSets) {
-      delete glyphSet.second->tex;
+    for (const std::pair<const uint32_t, GlyphSet*>& glyphSet : glyphSets) {
       delete glyphSet.second;
     }
   }
 
-  void Font::drawText(const std::string& text, const Colour& colour) {
-    activeGlyphSet->tex->makeActive();
-    mesh->begin(GL_TRIANGLES);
-    float x = 0;
-    uint8_t previous = 0;
-    float texH = activeGlyphSet->tex->getHeight();
-    float texW = activeGlyphSet->tex->getWidth();
-
-    for (uint8_t c : text) {
-      FontGlyph g = activeGlyphSet->glyphs[c];
-      
-      float y = pixelSize - g.bl;
-      
-      if (previous != 0) {
-        FT_Vector delta;
-        FT_Get_Kerning(face, previous, c, FT_KERNING_DEFAULT, &delta);
-        x += delta.x >> 6;
+  /**
+   * Strings are built into a mesh the first time they're drawn at a size,
+   * and the mesh is kept until MAX_CACHED_TEXT other strings have been
+   * drawn since.  A screen of text that doesn't change costs no vertex
+   * building or uploads.
+   */
+  void Font::drawText(Graphics* graphics, const std::string& text, const Colour& colour) {
+    uint32_t frame = graphics->getFrameNumber();
+    if (!retiredMeshes.empty() && retiredFrame != frame) {
+      freeRetiredMeshes();
+    }
+
+    std::pair<std::string, uint32_t> key(text, pixelSize);
+    std::map<std::pair<std::string, uint32_t>, CachedText>::iterator iter = textCache.find(key);
+
+    if (iter == textCache.end()) {
+      while (textCache.size() >= Font::MAX_CACHED_TEXT) {
+        evictText(frame);
       }
 
-      mesh->addVertex(Vector3(x, y, 0), Vector2(g.x, g.y), Colour(255, 255, 255));
-      mesh->addVertex(Vector3(x, y + (g.h * texH), 0), Vector2(g.x, g.y + g.h), Colour(255, 255, 255));
-      mesh->addVertex(Vector3(x + (g.w * texW), y + (g.h * texH), 0), Vector2(g.x + g.w, g.y + g.h), Colour(255, 255, 255));
+      CachedText cached;
+      buildTextMeshes(cached, text);
+      textOrder.push_front(key);
+      cached.order = textOrder.begin();
+      iter = textCache.insert(std::make_pair(key, cached)).first;
+    }
+    else {
+      textOrder.splice(textOrder.begin(), textOrder, iter->second.order);
+    }
+
+    iter->second.lastUsed = frame;
+    ShaderType shader = (renderMode == FontRenderMode::DISTANCE_FIELD) ? ShaderType::DISTANCE_FIELD_TEXT : ShaderType::BASIC;
+    for (std::pair<uint32_t, Mesh*> mesh : iter->second.meshes) {
+      graphics->drawMesh(mesh.second, atlas.getPage(mesh.first), BlendMode::CONSTANT_COLOUR, colour, shader);
+    }
+  }
+
+  float Font::getAdvance(const uint32_t previous, const uint32_t codePoint) {
+    float advance = getGlyph(codePoint).a;
+    if (previous != 0 && previous < Font::MAX_GLYPHS && codePoint < Font::MAX_GLYPHS) {
+      advance += getKerning(previous, codePoint);
+    }
+
+    return advance * getLayoutScale();
+  }
+
+  /**
+   * The pen moves by the same kerning and advances that TextLayout and
+   * buildTextMeshes() use, and the box reaches out to the right edge of any
+   * glyph that hangs past the pen, in pixels rather than atlas coordinates.
+   */
+  BoundingBox Font::getTextBoundingBox(const std::string& text) {
+    float x = 0.0f;
+    float right = 0.0f;
+
+    uint32_t previous = 0;
+    float scale = getLayoutScale();
+    float texW = GlyphAtlas::PAGE_SIZE * scale;
+    float left = (renderMode == FontRenderMode::DISTANCE_FIELD) ? Font::DISTANCE_FIELD_SPREAD * scale : 0.0f;
+    std::size_t index = 0;
+    while (index < text.size()) {
+      uint32_t c = decodeUTF8(text, index);
+      const FontGlyph& g = getGlyph(c);
+
+      if (previous != 0 && previous < Font::MAX_GLYPHS && c < Font::MAX_GLYPHS) {
+        x += getKerning(previous, c) * scale;
+      }
 
-      mesh->addVertex(Vector3(x + (g.w * texW), y + (g.h * texH), 0), Vector2(g.x + g.w, g.y + g.h), Colour(255, 255, 255));
-      mesh->addVertex(Vector3(x + (g.w * texW), y, 0), Vector2(g.x + g.w, g.y), Colour(255, 255, 255));
-      mesh->addVertex(Vector3(x, y, 0), Vector2(g.x, g.y), Colour(255, 255, 255));
+      //  Distance field glyphs have their border on both sides, and it's
+      //  left out, as it's only there for the field to fall off in.
+      if (g.w > 0.0f) {
+        right = std::max(right, x + (g.w * texW) - (2.0f * left));
+      }
 
-      x += g.a;
+      x += g.a * scale;
       previous = c;
     }
-    mesh->end();
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_CONSTANT_COLOR, GL_ONE_MINUS_SRC_COLOR);
-    float r, g, b, a;
-    r = (float)colour.getR() / 255.0f;
-    g = (float)colour.getG() / 255.0f;
-    b = (float)colour.getB() / 255.0f;
-    a = (float)colour.getA() / 255.0f;
+    return BoundingBox(0, 0, std::max(x, right), pixelSize);
+  }
+
+  /**
+   * Packs rasterized glyphs into the atlas, tallest first, which leaves the
+   * shelves much less ragged than code point order does.  Glyphs are still
+   * stored by code point, so only where they sit in the atlas changes.
+   */
+  void Font::addGlyphs(GlyphSet* glyphSet, const std::vector<RasterizedGlyph>& rasterized) {
+    std::vector<uint32_t> order;
+    for (uint32_t i = 0; i < rasterized.size() && i < Font::MAX_GLYPHS; i++) {
+      order.push_back(i);
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&rasterized](const uint32_t lhs, const uint32_t rhs) {
+      return rasterized[lhs].height > rasterized[rhs].height;
+    });
 
-    glBlendColor(r, g, b, a);
-    mesh->draw();
-    glDisable(GL_BLEND);
+    for (uint32_t i : order) {
+      placeGlyph(glyphSet->glyphs[i], rasterized[i], i);
+      glyphSet->loaded[i] = true;
+    }
   }
 
-  BoundingBox Font::getTextBoundingBox(const std::string& text) {
-    float w = 0.0f;
-    float h = 0.0f;
+  /**
+   * FT_Get_Kerning() wants glyph indices rather than character codes, so
+   * those are looked up first.
+   */
+  void Font::buildKerning(GlyphSet* glyphSet) {
+    if (!FT_HAS_KERNING(face)) {
+      return;
+    }
 
-    uint8_t previous = 0;
-    h = pixelSize;
-    for (uint8_t c : text) {
-      FontGlyph g = activeGlyphSet->glyphs[c];
+    FT_UInt indices[Font::MAX_GLYPHS];
+    for (uint32_t i = 0; i < Font::MAX_GLYPHS; i++) {
+      indices[i] = FT_Get_Char_Index(face, i);
+    }
 
-      float y = pixelSize - g.bl;
+    for (uint32_t left = 1; left < Font::MAX_GLYPHS; left++) {
+      for (uint32_t right = 0; right < Font::MAX_GLYPHS; right++) {
+        if (indices[left] == 0 || indices[right] == 0) {
+          continue;
+        }
 
-      if (previous != 0) {
         FT_Vector delta;
-        FT_Get_Kerning(face, previous, c, FT_KERNING_DEFAULT, &delta);
-        w += delta.x >> 6;
+        FT_Get_Kerning(face, indices[left], indices[right], FT_KERNING_DEFAULT, &delta);
+        if ((delta.x >> 6) != 0) {
+          glyphSet->sparseKerning[(left << 8) | right] = delta.x >> 6;
+        }
+      }
+    }
+  }
+
+  //  Moves fonts with lots of kerning pairs over to a dense table.
+  void Font::packKerning(GlyphSet* glyphSet) {
+    if (glyphSet->sparseKerning.size() > Font::DENSE_KERNING_PAIRS) {
+      glyphSet->denseKerning.resize(Font::MAX_GLYPHS * Font::MAX_GLYPHS, 0);
+      for (std::pair<uint16_t, int16_t> pair : glyphSet->sparseKerning) {
+        glyphSet->denseKerning[((pair.first >> 8) * Font::MAX_GLYPHS) + (pair.first & 0xFF)] = pair.second;
       }
+      glyphSet->sparseKerning.clear();
+    }
+  }
+
+  void Font::buildTextMeshes(CachedText& cached, const std::string& text) {
+    float x = 0;
+    uint32_t previous = 0;
+    float scale = getLayoutScale();
+    float texH = GlyphAtlas::PAGE_SIZE * scale;
+    float texW = GlyphAtlas::PAGE_SIZE * scale;
+
+    //  Distance field glyphs carry a border for the field to fall off in,
+    //  which hangs off to the left of the pen.
+    float left = (renderMode == FontRenderMode::DISTANCE_FIELD) ? Font::DISTANCE_FIELD_SPREAD * scale : 0.0f;
 
-      w += g.w;
-      w += g.a;
+    std::size_t index = 0;
+    while (index < text.size()) {
+      uint32_t c = decodeUTF8(text, index);
+      const FontGlyph& g = getGlyph(c);
+
+      float y = pixelSize - (g.bl * scale);
+
+      if (previous != 0 && previous < Font::MAX_GLYPHS && c < Font::MAX_GLYPHS) {
+        x += getKerning(previous, c) * scale;
+      }
+
+      //  Blank glyphs like spaces only move the pen along.
+      if (g.w > 0.0f && g.h > 0.0f) {
+        Mesh*& mesh = cached.meshes[g.page];
+        if (!mesh) {
+          mesh = new Mesh();
+          mesh->begin(GL_TRIANGLES);
+        }
+
+        float gx = x - left;
+        mesh->addVertex(Vector3(gx, y, 0), Vector2(g.x, g.y), Colour(255, 255, 255));
+        mesh->addVertex(Vector3(gx, y + (g.h * texH), 0), Vector2(g.x, g.y + g.h), Colour(255, 255, 255));
+        mesh->addVertex(Vector3(gx + (g.w * texW), y + (g.h * texH), 0), Vector2(g.x + g.w, g.y + g.h), Colour(255, 255, 255));
+
+        mesh->addVertex(Vector3(gx + (g.w * texW), y + (g.h * texH), 0), Vector2(g.x + g.w, g.y + g.h), Colour(255, 255, 255));
+        mesh->addVertex(Vector3(gx + (g.w * texW), y, 0), Vector2(g.x + g.w, g.y), Colour(255, 255, 255));
+        mesh->addVertex(Vector3(gx, y, 0), Vector2(g.x, g.y), Colour(255, 255, 255));
+      }
+
+      x += g.a * scale;
       previous = c;
     }
-    return BoundingBox(0, 0, w, h);
+
+    for (std::pair<uint32_t, Mesh*> mesh : cached.meshes) {
+      mesh.second->end();
+    }
+  }
+
+  /**
+   * Throws away the text drawn longest ago.  If that was this frame, its
+   * meshes are still waiting in the render queue, so they're kept until a
+   * later frame rather than deleted.
+   */
+  void Font::evictText(const uint32_t frame) {
+    std::map<std::pair<std::string, uint32_t>, CachedText>::iterator iter = textCache.find(textOrder.back());
+    for (std::pair<uint32_t, Mesh*> mesh : iter->second.meshes) {
+      if (iter->second.lastUsed == frame) {
+        retiredMeshes.push_back(mesh.second);
+        retiredFrame = frame;
+      }
+      else {
+        delete mesh.second;
+      }
+    }
+
+    textCache.erase(iter);
+    textOrder.pop_back();
+  }
+
+  void Font::freeRetiredMeshes() {
+    for (Mesh* mesh : retiredMeshes) {
+      delete mesh;
+    }
+    retiredMeshes.clear();
+  }
+
+  /**
+   * Returns the glyph for a code point at the active size, rasterizing it
+   * into the atlas if this is the first time it's been asked for.  The face
+   * is already set to the active size by setPixelSize().
+   */
+  const FontGlyph& Font::getGlyph(const uint32_t codePoint) {
+    FontGlyph* glyph;
+    if (codePoint < Font::MAX_GLYPHS) {
+      glyph = &activeGlyphSet->glyphs[codePoint];
+      if (activeGlyphSet->loaded[codePoint]) {
+        return *glyph;
+      }
+      activeGlyphSet->loaded[codePoint] = true;
+    }
+    else {
+      std::map<uint32_t, FontGlyph>::iterator iter = activeGlyphSet->extendedGlyphs.find(codePoint);
+      if (iter != activeGlyphSet->extendedGlyphs.end()) {
+        return iter->second;
+      }
+      glyph = &activeGlyphSet->extendedGlyphs[codePoint];
+    }
+
+    RasterizedGlyph rasterized;
+    if (face) {
+      rasterizeGlyph(face, codePoint, renderMode, rasterized);
+    }
+    placeGlyph(*glyph, rasterized, codePoint);
+
+    return *glyph;
+  }
+
+  /**
+   * Sits next to the font, e.g. data/DejaVuSansMono-24.glyphs, or
+   * data/DejaVuSansMono-sdf32.glyphs for distance fields.
+   */
+  std::string Font::getGlyphCacheFilename(const uint32_t pixelSize) const {
+    std::string mode = (renderMode == FontRenderMode::DISTANCE_FIELD) ? "sdf" : "";
+    return path(filename).replace_extension().string() + "-" + mode + std::to_string(pixelSize) + ".glyphs";
+  }
+
+  /**
+   * Replaces a glyph's coverage with the signed distance to its outline,
+   * found by searching DISTANCE_FIELD_SPREAD pixels around each pixel for
+   * one on the other side of the edge.  The outline maps to 128, and the
+   * glyph grows by the spread on every side so the field has room to fall
+   * off.
+   */
+  void Font::makeDistanceField(RasterizedGlyph& glyph) {
+    const int32_t spread = Font::DISTANCE_FIELD_SPREAD;
+    int32_t width = glyph.width;
+    int32_t height = glyph.height;
+    int32_t paddedWidth = width + (spread * 2);
+    int32_t paddedHeight = height + (spread * 2);
+
+    std::vector<bool> inside(paddedWidth * paddedHeight, false);
+    for (int32_t y = 0; y < height; y++) {
+      for (int32_t x = 0; x < width; x++) {
+        inside[((y + spread) * paddedWidth) + x + spread] = (glyph.pixels[(y * width) + x] >= 128);
+      }
+    }
+
+    std::vector<uint8_t> field(paddedWidth * paddedHeight);
+    for (int32_t y = 0; y < paddedHeight; y++) {
+      for (int32_t x = 0; x < paddedWidth; x++) {
+        bool in = inside[(y * paddedWidth) + x];
+        float nearest = spread;
+
+        for (int32_t dy = -spread; dy <= spread; dy++) {
+          for (int32_t dx = -spread; dx <= spread; dx++) {
+            int32_t sx = x + dx;
+            int32_t sy = y + dy;
+            bool other = (sx >= 0 && sy >= 0 && sx < paddedWidth && sy < paddedHeight) ? inside[(sy * paddedWidth) + sx] : false;
+            if (other != in) {
+              nearest = std::min(nearest, std::sqrt((float)((dx * dx) + (dy * dy))));
+            }
+          }
+        }
+
+        //  The edge is halfway between the centres of the two pixels.
+        float distance = in ? nearest - 0.5f : 0.5f - nearest;
+        float value = 0.5f + (distance / (spread * 2));
+        field[(y * paddedWidth) + x] = (uint8_t)std::max(0.0f, std::min(255.0f, value * 255.0f));
+      }
+    }
+
+    glyph.width = paddedWidth;
+    glyph.height = paddedHeight;
+    glyph.bl += spread;
+    glyph.pixels.swap(field);
+  }
+
+  void Font::placeGlyph(FontGlyph& glyph, const RasterizedGlyph& source, const uint32_t codePoint) {
+    //  Store all the attributes of the glyph that we're interested in,
+    //  namely, texture position, dimensions, advance and baseline
+    //  adjustment.
+    glyph.page = 0;
+    glyph.x = 0.0f;
+    glyph.y = 0.0f;
+    glyph.w = 0.0f;
+    glyph.h = 0.0f;
+    glyph.a = source.a;
+    glyph.bl = source.bl;
+
+    uint32_t x;
+    uint32_t y;
+    if (source.width > 0 && source.height > 0) {
+      if (atlas.insert(source.width, source.height, source.pixels.data(), source.width, glyph.page, x, y)) {
+        glyph.x = (float)x / GlyphAtlas::PAGE_SIZE;
+        glyph.y = (float)y / GlyphAtlas::PAGE_SIZE;
+        glyph.w = (float)source.width / GlyphAtlas::PAGE_SIZE;
+        glyph.h = (float)source.height / GlyphAtlas::PAGE_SIZE;
+      }
+      else {
+        writeToLog(MessageLevel::WARNING, "Font::placeGlyph():  Glyph U+%04X is too large for the atlas.\n", codePoint);
+      }
+    }
   }
 
   bool Font::loadFont(const std::string& filename) {
+    this->filename = filename;
+
     path p(filename);
     if (exists(p) && is_regular_file(p)) {
       FT_New_Face(library, filename.c_str(), 0, &face);
+
+      //  FNV-1a over the whole file, which ties cached glyph sets to it.
+      std::ifstream file(filename.c_str(), std::ios::binary | std::ios::in);
+      std::vector<char> buffer(64 * 1024);
+      fontHash = 2166136261u;
+      while (file) {
+        file.read(buffer.data(), buffer.size());
+        for (std::streamsize i = 0; i < file.gcount(); i++) {
+          fontHash ^= (uint8_t)buffer[i];
+          fontHash *= 16777619u;
+        }
+      }
     }
 
     return true;
   }
 
-  void Font::setPixelSize(const uint32_t pixelSize) {
-    FT_Set_Char_Size(face, 0, pixelSize << 6, 96, 96);
+  /**
+   * Loads the glyphs and kerning pairs of a size saved by saveGlyphCache().
+   * Fails if the file is damaged, or was made from a different font file.
+   */
+  bool Font::loadGlyphCache(const std::string& cacheFilename, std::vector<RasterizedGlyph>& rasterized, GlyphSet* glyphSet) const {
+    std::ifstream file;
+    file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
 
-    if (glyphSets.count(pixelSize) > 0) {
-      activeGlyphSet = glyphSets.at(pixelSize);
-    }
+    try {
+      file.open(cacheFilename.c_str(), std::ios::binary | std::ios::in);
 
-    //  First, figure out what the dimensions are of the largest glyph in
-    //  pixels.
-    uint32_t maxGlyphWidth = 0;
-    uint32_t maxGlyphHeight = 0;
+      char magic[4];
+      uint32_t version = 0;
+      uint32_t hash = 0;
+      uint32_t size = 0;
+      uint32_t mode = 0;
+      uint32_t glyphCount = 0;
+      uint32_t pairCount = 0;
+      file.read(magic, sizeof(magic));
+      file.read((char*)&version, sizeof(version));
+      file.read((char*)&hash, sizeof(hash));
+      file.read((char*)&size, sizeof(size));
+      file.read((char*)&mode, sizeof(mode));
+      file.read((char*)&glyphCount, sizeof(glyphCount));
+      file.read((char*)&pairCount, sizeof(pairCount));
 
-    for (uint32_t i = 0; i < Font::MAX_GLYPHS; i++) {
-      FT_Load_Char(face, i, FT_LOAD_RENDER);
-      if (face->glyph->bitmap.width > maxGlyphWidth) {
-        maxGlyphWidth = face->glyph->bitmap.width;
+      if (::memcmp(magic, GLYPH_CACHE_MAGIC, sizeof(magic)) != 0 ||
+          version != Font::GLYPH_CACHE_VERSION) {
+        throw std::runtime_error("Font::loadGlyphCache():  Not a glyph cache, or an old one.");
+      }
+
+      if (hash != fontHash || size != getRasterSize() || mode != (uint32_t)renderMode || glyphCount != Font::MAX_GLYPHS ||
+          pairCount > Font::MAX_GLYPHS * Font::MAX_GLYPHS) {
+        throw std::runtime_error("Font::loadGlyphCache():  Glyph cache was made for a different font.");
+      }
+
+      rasterized.resize(glyphCount);
+      for (RasterizedGlyph& glyph : rasterized) {
+        file.read((char*)&glyph.a, sizeof(glyph.a));
+        file.read((char*)&glyph.bl, sizeof(glyph.bl));
+        file.read((char*)&glyph.width, sizeof(glyph.width));
+        file.read((char*)&glyph.height, sizeof(glyph.height));
+
+        if (glyph.width > GlyphAtlas::PAGE_SIZE || glyph.height > GlyphAtlas::PAGE_SIZE) {
+          throw std::runtime_error("Font::loadGlyphCache():  Glyph cache is damaged.");
+        }
+
+        glyph.pixels.resize(glyph.width * glyph.height);
+        if (!glyph.pixels.empty()) {
+          file.read((char*)glyph.pixels.data(), glyph.pixels.size());
+        }
       }
 
-      if (face->glyph->bitmap.rows > maxGlyphHeight) {
-        maxGlyphHeight = face->glyph->bitmap.rows;
+      for (uint32_t i = 0; i < pairCount; i++) {
+        uint16_t pair = 0;
+        int16_t kerning = 0;
+        file.read((char*)&pair, sizeof(pair));
+        file.read((char*)&kerning, sizeof(kerning));
+        glyphSet->sparseKerning[pair] = kerning;
       }
+
+      file.close();
     }
+    catch (std::exception& e) {
+      rasterized.clear();
+      glyphSet->sparseKerning.clear();
 
-    //  Calculate image dimensions based on the above.
-    uint32_t imageWidth = minPowerOfTwo(16 * maxGlyphWidth);
-    uint32_t imageHeight = minPowerOfTwo(16 * maxGlyphHeight);
-    uint32_t xOffset = imageWidth / 16;
-    uint32_t yOffset = imageHeight / 16;
+      if (file.is_open()) {
+        file.close();
+      }
 
-    Image m;
-    m.setSize(imageWidth, imageHeight);
-    GlyphSet* glyphSet = new GlyphSet;
+      writeToLog(MessageLevel::WARNING, "Could not load glyph cache \"%s\":  %s\n", cacheFilename.c_str(), e.what());
+      return false;
+    }
 
-    for (uint32_t i = 0; i < Font::MAX_GLYPHS; i++) {
-      FT_Load_Char(face, i, FT_LOAD_RENDER);
-
-      float texX = (float)((i % 16) * xOffset) / imageWidth;
-      float texY = (float)((i / 16) * yOffset) / imageHeight;
-
-      //  Store all the attributes of the glyph that we're interested in,
-      //  namely, texture position, dimensions, advance and baseline
-      //  adjustment.
-      glyphSet->glyphs[i].x = texX;
-      glyphSet->glyphs[i].y = texY;
-      glyphSet->glyphs[i].w = (float)face->glyph->bitmap.width / imageWidth;
-      glyphSet->glyphs[i].h = (float)face->glyph->bitmap.rows / imageHeight;
-      glyphSet->glyphs[i].a = face->glyph->metrics.horiAdvance >> 6;
-      glyphSet->glyphs[i].bl = face->glyph->metrics.horiBearingY >> 6;
-
-      //  Where to draw in the texture image.
-      uint32_t baseX = (i % 16) * xOffset;
-      uint32_t baseY = (i / 16) * yOffset;
-
-      for (uint32_t y = 0; y < face->glyph->bitmap.rows; y++) {
-        for (uint32_t x = 0; x < face->glyph->bitmap.width; x++) {
-          uint8_t pix = face->glyph->bitmap.buffer[(y * face->glyph->bitmap.width) + x];
-          m.setPixel(baseX + x, baseY + y, pix, pix, pix, 255);
+    return true;
+  }
+
+  void Font::rasterizeGlyph(FT_Face face, const uint32_t codePoint, const FontRenderMode mode, RasterizedGlyph& glyph) {
+    glyph.a = 0.0f;
+    glyph.bl = 0.0f;
+    glyph.width = 0;
+    glyph.height = 0;
+    glyph.pixels.clear();
+
+    //  Code points the font has no glyph for, like the control codes, would
+    //  otherwise all take up room in the atlas as copies of the same box.
+    if (FT_Get_Char_Index(face, codePoint) == 0 || FT_Load_Char(face, codePoint, FT_LOAD_RENDER) != 0) {
+      return;
+    }
+
+    //  FreeType rows may be padded, or even stored bottom up.
+    FT_Bitmap& bitmap = face->glyph->bitmap;
+    glyph.a = face->glyph->metrics.horiAdvance >> 6;
+    glyph.bl = face->glyph->metrics.horiBearingY >> 6;
+    glyph.width = bitmap.width;
+    glyph.height = bitmap.rows;
+    glyph.pixels.resize(glyph.width * glyph.height);
+    for (uint32_t y = 0; y < glyph.height; y++) {
+      const uint8_t* row = (bitmap.pitch >= 0) ? bitmap.buffer + (y * bitmap.pitch) : bitmap.buffer + ((glyph.height - 1 - y) * -bitmap.pitch);
+      std::copy(row, row + glyph.width, glyph.pixels.begin() + (y * glyph.width));
+    }
+
+    if (mode == FontRenderMode::DISTANCE_FIELD && glyph.width > 0 && glyph.height > 0) {
+      makeDistanceField(glyph);
+    }
+  }
+
+  bool Font::rasterizeGlyphs(const std::string& filename, const uint32_t pixelSize, const FontRenderMode mode, std::vector<RasterizedGlyph>& rasterized, uint32_t threadCount) {
+    if (threadCount == 0) {
+      threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threadCount = std::min(threadCount, Font::MAX_GLYPHS);
+
+    rasterized.clear();
+    rasterized.resize(Font::MAX_GLYPHS);
+
+    //  Each thread takes every threadCount'th code point, and only ever
+    //  writes to those glyphs and its own entry in failed.
+    std::vector<uint8_t> failed(threadCount, 0);
+    std::vector<std::thread> workers;
+    for (uint32_t t = 0; t < threadCount; t++) {
+      workers.push_back(std::thread([&filename, pixelSize, mode, &rasterized, &failed, t, threadCount]() {
+        FT_Library library;
+        FT_Face face;
+        if (FT_Init_FreeType(&library) != 0) {
+          failed[t] = 1;
+          return;
+        }
+
+        if (FT_New_Face(library, filename.c_str(), 0, &face) == 0) {
+          FT_Set_Char_Size(face, 0, pixelSize << 6, 96, 96);
+
+          for (uint32_t i = t; i < Font::MAX_GLYPHS; i += threadCount) {
+            rasterizeGlyph(face, i, mode, rasterized[i]);
+          }
+
+          FT_Done_Face(face);
+        }
+        else {
+          failed[t] = 1;
+        }
+
+        FT_Done_FreeType(library);
+      }));
+    }
+
+    for (std::thread& worker : workers) {
+      worker.join();
+    }
+
+    return (std::find(failed.begin(), failed.end(), 1) == failed.end());
+  }
+
+  bool Font::saveGlyphCache(const std::string& cacheFilename, const std::vector<RasterizedGlyph>& rasterized, const GlyphSet* glyphSet) const {
+    std::ofstream file;
+    file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+
+    try {
+      file.open(cacheFilename.c_str(), std::ios::binary | std::ios::out | std::ios::trunc);
+
+      uint32_t version = Font::GLYPH_CACHE_VERSION;
+      uint32_t size = getRasterSize();
+      uint32_t mode = (uint32_t)renderMode;
+      uint32_t glyphCount = rasterized.size();
+      uint32_t pairCount = glyphSet->sparseKerning.size();
+      file.write(GLYPH_CACHE_MAGIC, sizeof(GLYPH_CACHE_MAGIC));
+      file.write((const char*)&version, sizeof(version));
+      file.write((const char*)&fontHash, sizeof(fontHash));
+      file.write((const char*)&size, sizeof(size));
+      file.write((const char*)&mode, sizeof(mode));
+      file.write((const char*)&glyphCount, sizeof(glyphCount));
+      file.write((const char*)&pairCount, sizeof(pairCount));
+
+      for (const RasterizedGlyph& glyph : rasterized) {
+        file.write((const char*)&glyph.a, sizeof(glyph.a));
+        file.write((const char*)&glyph.bl, sizeof(glyph.bl));
+        file.write((const char*)&glyph.width, sizeof(glyph.width));
+        file.write((const char*)&glyph.height, sizeof(glyph.height));
+        if (!glyph.pixels.empty()) {
+          file.write((const char*)glyph.pixels.data(), glyph.pixels.size());
         }
       }
+
+      for (std::pair<uint16_t, int16_t> pair : glyphSet->sparseKerning) {
+        file.write((const char*)&pair.first, sizeof(pair.first));
+        file.write((const char*)&pair.second, sizeof(pair.second));
+      }
+
+      file.close();
     }
-    glyphSet->tex = new Texture(&m);
-    this->glyphSets[pixelSize] = glyphSet;
-    activeGlyphSet = glyphSet;
+    catch (std::exception& e) {
+      if (file.is_open()) {
+        file.close();
+      }
+
+      writeToLog(MessageLevel::WARNING, "Could not save glyph cache \"%s\":  %s\n", cacheFilename.c_str(), e.what());
+      return false;
+    }
+
+    return true;
+  }
+
+  /**
+   * Bitmap fonts get a glyph set for each size.  Distance field fonts only
+   * ever have the one, which every size is scaled from.
+   */
+  void Font::setPixelSize(const uint32_t pixelSize) {
     this->pixelSize = pixelSize;
+    uint32_t rasterSize = getRasterSize();
+    FT_Set_Char_Size(face, 0, rasterSize << 6, 96, 96);
+
+    if (glyphSets.count(rasterSize) > 0) {
+      activeGlyphSet = glyphSets.at(rasterSize);
+      return;
+    }
+
+    GlyphSet* glyphSet = new GlyphSet;
+    for (uint32_t i = 0; i < Font::MAX_GLYPHS; i++) {
+      glyphSet->loaded[i] = false;
+    }
+
+    this->glyphSets[rasterSize] = glyphSet;
+    activeGlyphSet = glyphSet;
+
+    if (!face) {
+      return;
+    }
+
+    //  The first MAX_GLYPHS code points are rendered up front, or loaded
+    //  from the cache if an earlier run already rendered them.  Anything
+    //  else is left for getGlyph() to rasterize when it's first used.
+    std::string cacheFilename = getGlyphCacheFilename(rasterSize);
+    std::vector<RasterizedGlyph> rasterized;
+    if (exists(cacheFilename) && loadGlyphCache(cacheFilename, rasterized, glyphSet)) {
+      writeToLog(MessageLevel::INFO, "Loaded %upx glyphs from \"%s\".\n", rasterSize, cacheFilename.c_str());
+    }
+    else {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      bool complete = rasterizeGlyphs(filename, rasterSize, renderMode, rasterized);
+      buildKerning(glyphSet);
+      std::chrono::milliseconds elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+      //  Glyphs a worker couldn't get to are left blank, and caching them
+      //  would keep them blank on every run after this one.
+      if (complete) {
+        writeToLog(MessageLevel::INFO, "Rasterized %upx glyphs in %lldms.\n", rasterSize, (long long)elapsed.count());
+        saveGlyphCache(cacheFilename, rasterized, glyphSet);
+      }
+      else {
+        writeToLog(MessageLevel::WARNING, "Could not rasterize every %upx glyph of \"%s\", so they won't be cached.\n", rasterSize, filename.c_str());
+      }
+    }
+
+    addGlyphs(glyphSet, rasterized);
+    packKerning(glyphSet);
   }
 }
@@ -18,9 +18,13 @@
 
 #include "FontGlyph.hpp"
 #include <string>
+#include <list>
 #include <map>
+#include <utility>
+#include <vector>
 #include <ft2build.h>
 #include FT_FREETYPE_H
+#include "GlyphAtlas.hpp"
 #include "Texture.hpp"
 #include "Mesh.hpp"
 #include "BoundingBox.hpp"
@@ -28,22 +32,47 @@
 #include "Colour.hpp"
 
 namespace io {
+  class Graphics;
+
+  /**
+   * BITMAP fonts rasterize every size they're used at, and draw the glyph
+   * coverage as is.  DISTANCE_FIELD fonts rasterize a single size as
+   * signed distance fields, which are scaled to any size and drawn with
+   * the DISTANCE_FIELD variant of data/fragment.glsl.
+   */
+  enum class FontRenderMode : uint8_t {
+    BITMAP,
+    DISTANCE_FIELD
+  };
+
   /**
-   * To make proper use of this class in OpenGL, GL_BLEND needs to be enabled,
-   * and the blending functions need to be set to GL_CONSTANT_COLOR for the
-   * source factor, and GL_ONE_MINUS_SRC_COLOR for the destination factor.
-   * To change the rendering colour of the text, use glBlendColor().
+   * Text is drawn by blending with GL_CONSTANT_COLOR for the source factor,
+   * and GL_ONE_MINUS_SRC_COLOR for the destination factor, with the blend
+   * colour as the colour of the text.  drawText() queues the text with
+   * Graphics, which sets this up when the text is drawn.
    */
   class Font : public Resource {
     public:
-      Font(FT_Library library, const std::string& filename);
+      Font(FT_Library library, const std::string& filename, const FontRenderMode renderMode = FontRenderMode::BITMAP);
       virtual ~Font();
       
-      void drawText(const std::string& text, const Colour& colour = Colour(255, 255, 255, 255));
+      void drawText(Graphics* g, const std::string& text, const Colour& colour = Colour(255, 255, 255, 255));
+
+      /**
+       * How far the pen moves for a code point at the current size,
+       * including its kerning against the one before it.  previous is 0 at
+       * the start of a line.
+       */
+      float getAdvance(const uint32_t previous, const uint32_t codePoint);
+
       uint32_t getPixelSize() const {
         return pixelSize;
       }
 
+      FontRenderMode getRenderMode() const {
+        return renderMode;
+      }
+
       void setPixelSize(const uint32_t pixelSize);
       BoundingBox getTextBoundingBox(const std::string& text);
 
@@ -53,24 +82,129 @@ namespace io {
     private:
       const static uint32_t DEFAULT_PIXEL_SIZE = 12;
       const static uint32_t MAX_GLYPHS = 256;
+
+      //  No more than this many strings are cached.  The one drawn longest
+      //  ago makes room for each new one.
+      const static uint32_t MAX_CACHED_TEXT = 256;
       
       Font(const Font&);
       Font& operator=(const Font&);
 
+      //  Fonts with more kerning pairs than this get a dense table.
+      const static uint32_t DENSE_KERNING_PAIRS = 4096;
+
+      const static uint32_t GLYPH_CACHE_VERSION = 2;
+
+      //  The size distance field glyphs are rasterized at, and how many
+      //  pixels the field reaches out from the outline.
+      const static uint32_t DISTANCE_FIELD_SIZE = 32;
+      const static uint32_t DISTANCE_FIELD_SPREAD = 4;
+
+      //  A glyph as FreeType rendered it, before it goes into the atlas.
+      struct RasterizedGlyph {
+          float a;
+          float bl;
+          uint32_t width;
+          uint32_t height;
+          std::vector<uint8_t> pixels;
+      };
+
+      /**
+       * Glyphs are rasterized the first time they're needed and packed into
+       * the font's atlas, which is shared by every size.  The first
+       * MAX_GLYPHS code points are kept in a flat array, anything past that
+       * in a map.
+       *
+       * Kerning is looked up when the glyph set is built, so laying out text
+       * never has to call into FreeType.  Fonts with lots of pairs get a
+       * full MAX_GLYPHS x MAX_GLYPHS table, others just keep the pairs that
+       * kern, and fonts with none keep nothing.
+       */
       struct GlyphSet {
-          Texture* tex;
           FontGlyph glyphs[Font::MAX_GLYPHS];
+          bool loaded[Font::MAX_GLYPHS];
+          std::map<uint32_t, FontGlyph> extendedGlyphs;
+          std::vector<int16_t> denseKerning;
+          std::map<uint16_t, int16_t> sparseKerning;
       };
 
       std::map<uint32_t, GlyphSet*> glyphSets;
 
+      //  A string is split into a mesh for each atlas page it uses.
+      struct CachedText {
+          std::map<uint32_t, Mesh*> meshes;
+          uint32_t lastUsed;
+          std::list<std::pair<std::string, uint32_t>>::iterator order;
+      };
+
+      //  Built text, by string and pixel size, and the keys from the most
+      //  recently drawn to the least.
+      std::map<std::pair<std::string, uint32_t>, CachedText> textCache;
+      std::list<std::pair<std::string, uint32_t>> textOrder;
+
+      //  Meshes of text thrown out in the frame it was drawn, which are
+      //  still waiting in the render queue, and the frame that was.
+      std::vector<Mesh*> retiredMeshes;
+      uint32_t retiredFrame;
+
+      GlyphAtlas atlas;
       GlyphSet* activeGlyphSet;
       FT_Library library;
       FT_Face face;
-      Mesh* mesh;
+      std::string filename;
+      uint32_t fontHash;
       uint32_t pixelSize;
+      FontRenderMode renderMode;
+
+      void addGlyphs(GlyphSet* glyphSet, const std::vector<RasterizedGlyph>& rasterized);
+      void buildKerning(GlyphSet* glyphSet);
+      void buildTextMeshes(CachedText& cached, const std::string& text);
+      void evictText(const uint32_t frame);
+      void freeRetiredMeshes();
+      const FontGlyph& getGlyph(const uint32_t codePoint);
+      std::string getGlyphCacheFilename(const uint32_t pixelSize) const;
+
+      //  How much glyph metrics are scaled by to lay text out at pixelSize.
+      float getLayoutScale() const {
+        return (float)pixelSize / getRasterSize();
+      }
+
+      //  The size glyphs are actually rasterized at.
+      uint32_t getRasterSize() const {
+        return (renderMode == FontRenderMode::DISTANCE_FIELD) ? Font::DISTANCE_FIELD_SIZE : pixelSize;
+      }
 
       bool loadFont(const std::string& filename);
+      bool loadGlyphCache(const std::string& cacheFilename, std::vector<RasterizedGlyph>& rasterized, GlyphSet* glyphSet) const;
+      void packKerning(GlyphSet* glyphSet);
+      void placeGlyph(FontGlyph& glyph, const RasterizedGlyph& source, const uint32_t codePoint);
+      bool saveGlyphCache(const std::string& cacheFilename, const std::vector<RasterizedGlyph>& rasterized, const GlyphSet* glyphSet) const;
+
+      /**
+       * Renders the first MAX_GLYPHS code points at a size.  Faces can't be
+       * shared between threads, so each worker opens the font itself.  A
+       * thread count of 0 uses one thread per hardware thread.  Returns
+       * false if a worker couldn't open the font, leaving its glyphs blank.
+       */
+      static bool rasterizeGlyphs(const std::string& filename, const uint32_t pixelSize, const FontRenderMode mode, std::vector<RasterizedGlyph>& rasterized, uint32_t threadCount = 0);
+      static void makeDistanceField(RasterizedGlyph& glyph);
+      static void rasterizeGlyph(FT_Face face, const uint32_t codePoint, const FontRenderMode mode, RasterizedGlyph& glyph);
+
+      //  The kerning between two characters in pixels, for the active size.
+      int32_t getKerning(const uint8_t left, const uint8_t right) const {
+        if (!activeGlyphSet->denseKerning.empty()) {
+          return activeGlyphSet->denseKerning[(left * Font::MAX_GLYPHS) + right];
+        }
+
+        if (!activeGlyphSet->sparseKerning.empty()) {
+          std::map<uint16_t, int16_t>::const_iterator iter = activeGlyphSet->sparseKerning.find((left << 8) | right);
+          if (iter != activeGlyphSet->sparseKerning.end()) {
+            return iter->second;
+          }
+        }
+
+        return 0;
+      }
   };
 }
 
@@ -16,9 +16,13 @@
 #ifndef FontGlyphHPP
 #define FontGlyphHPP
 
+#include <cstdint>
+
 namespace io {
   class FontGlyph {
     public:
+      //  The glyph atlas page it was packed on.
+      uint32_t page;
       float x;
       float y;
       float w;
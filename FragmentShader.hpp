@@ -24,8 +24,8 @@
 namespace io {
   class FragmentShader : public Shader {
   public:
-    FragmentShader(const std::string& filename) : Shader() {
-      this->loadShaderFromFile(filename);
+    FragmentShader(const std::string& filename, const std::string& preamble = std::string()) : Shader() {
+      this->loadShaderFromFile(filename, preamble);
     }
 
     virtual ~FragmentShader() {
@@ -0,0 +1,129 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#ifndef FrameStatisticsHPP
+#define FrameStatisticsHPP
+
+#include <cstdint>
+#include <ostream>
+
+namespace io {
+  /**
+   * Counters describing the work done to draw the current frame.  They are
+   * reset by Graphics::beginFrame().
+   */
+  struct FrameStatistics {
+    FrameStatistics() {
+      reset();
+    }
+
+    void reset() {
+      cellsTested = 0;
+      cellsSubmitted = 0;
+      chunksTested = 0;
+      chunksSubmitted = 0;
+      matrixChanges = 0;
+      matrixUploads = 0;
+      uniformUploads = 0;
+      stateChangesIssued = 0;
+      stateChangesSkipped = 0;
+      renderCommands = 0;
+      drawCalls = 0;
+      verticesSubmitted = 0;
+      textureBinds = 0;
+      bufferUploads = 0;
+      bufferUploadBytes = 0;
+      batchedDrawCalls = 0;
+      batchedQuads = 0;
+      screensRedrawn = 0;
+      gameDrawMicroseconds = 0;
+      mapDrawMicroseconds = 0;
+      submitMicroseconds = 0;
+    }
+
+    static void writeCSVHeader(std::ostream& out) {
+      out << "cellsTested,cellsSubmitted,chunksTested,chunksSubmitted,"
+          << "matrixChanges,matrixUploads,stateChangesIssued,stateChangesSkipped,"
+          << "renderCommands,drawCalls,verticesSubmitted,textureBinds,"
+          << "bufferUploads,bufferUploadBytes,gameDrawMicroseconds,"
+          << "mapDrawMicroseconds,submitMicroseconds,batchedDrawCalls,"
+          << "batchedQuads,screensRedrawn,uniformUploads\n";
+    }
+
+    void writeCSV(std::ostream& out) const {
+      out << cellsTested << ',' << cellsSubmitted << ','
+          << chunksTested << ',' << chunksSubmitted << ','
+          << matrixChanges << ',' << matrixUploads << ','
+          << stateChangesIssued << ',' << stateChangesSkipped << ','
+          << renderCommands << ',' << drawCalls << ','
+          << verticesSubmitted << ',' << textureBinds << ','
+          << bufferUploads << ',' << bufferUploadBytes << ','
+          << gameDrawMicroseconds << ',' << mapDrawMicroseconds << ','
+          << submitMicroseconds << ',' << batchedDrawCalls << ','
+          << batchedQuads << ',' << screensRedrawn << ','
+          << uniformUploads << '\n';
+    }
+
+    //  Map cells in the per-tile draw window, and the open cells that
+    //  survived culling and were drawn.
+    uint32_t cellsTested;
+    uint32_t cellsSubmitted;
+
+    //  Baked chunks considered by the culling stage, and those actually drawn.
+    uint32_t chunksTested;
+    uint32_t chunksSubmitted;
+
+    //  Changes made to the model, view and projection matrices, each of
+    //  which used to be an upload, and the uploads actually made.
+    uint32_t matrixChanges;
+    uint32_t matrixUploads;
+
+    //  The other uniforms set during a frame: the generic shader's feature
+    //  flags and the sprite batch's sample mode.
+    uint32_t uniformUploads;
+
+    //  GL state changes made by GLState, and the ones it dropped because
+    //  they wouldn't have changed anything.
+    uint32_t stateChangesIssued;
+    uint32_t stateChangesSkipped;
+
+    //  Draws queued with the render queue.
+    uint32_t renderCommands;
+
+    //  What actually went to GL.  A multi-draw or instanced draw is one call.
+    uint32_t drawCalls;
+    uint32_t verticesSubmitted;
+    uint32_t textureBinds;
+    uint32_t bufferUploads;
+    uint32_t bufferUploadBytes;
+
+    //  Draw calls made for the sprite batch, which are also counted in
+    //  drawCalls, and the quads that went into them.
+    uint32_t batchedDrawCalls;
+    uint32_t batchedQuads;
+
+    //  Cached screens that had to be drawn again, rather than just put back
+    //  on the screen.
+    uint32_t screensRedrawn;
+
+    //  CPU time spent building the frame in Game::draw(), the part of that
+    //  spent in Map::draw(), and the time spent making the queued draws.
+    uint32_t gameDrawMicroseconds;
+    uint32_t mapDrawMicroseconds;
+    uint32_t submitMicroseconds;
+  };
+}
+
+#endif // FrameStatisticsHPP
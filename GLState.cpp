@@ -0,0 +1,236 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#include "GLState.hpp"
+#include <cmath>
+
+namespace io {
+  GLState* GLState::instance = nullptr;
+
+  GLState::GLState()
+    : statistics(nullptr) {
+    invalidate();
+  }
+
+  void GLState::bindArrayBuffer(const GLuint buffer) {
+    if (change(arrayBuffer != buffer)) {
+      glBindBuffer(GL_ARRAY_BUFFER, buffer);
+      arrayBuffer = buffer;
+    }
+  }
+
+  void GLState::bindFramebuffer(const GLuint framebuffer) {
+    if (change(this->framebuffer != framebuffer)) {
+      glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+      this->framebuffer = framebuffer;
+    }
+  }
+
+  void GLState::bindTexture(const GLuint texture, const uint32_t unit) {
+    if (unit >= GLState::MAX_TEXTURE_UNITS || !change(textures[unit] != texture)) {
+      return;
+    }
+
+    if (activeTextureUnit != unit) {
+      glActiveTexture(GL_TEXTURE0 + unit);
+      activeTextureUnit = unit;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    textures[unit] = texture;
+
+    if (statistics) {
+      statistics->textureBinds++;
+    }
+  }
+
+  void GLState::bindVertexArray(const GLuint vertexArray) {
+    if (change(this->vertexArray != vertexArray)) {
+      glBindVertexArray(vertexArray);
+      this->vertexArray = vertexArray;
+    }
+  }
+
+  void GLState::useProgram(const GLuint program) {
+    if (change(this->program != program)) {
+      glUseProgram(program);
+      this->program = program;
+    }
+  }
+
+  void GLState::setBlend(const bool enabled) {
+    if (change(blend != (GLuint)enabled)) {
+      if (enabled) {
+        glEnable(GL_BLEND);
+      }
+      else {
+        glDisable(GL_BLEND);
+      }
+
+      blend = enabled;
+    }
+  }
+
+  void GLState::setBlendColour(const float r, const float g, const float b, const float a) {
+    if (change(blendColour[0] != r || blendColour[1] != g ||
+               blendColour[2] != b || blendColour[3] != a)) {
+      glBlendColor(r, g, b, a);
+      blendColour[0] = r;
+      blendColour[1] = g;
+      blendColour[2] = b;
+      blendColour[3] = a;
+    }
+  }
+
+  void GLState::setBlendFunc(const GLenum source, const GLenum destination) {
+    if (change(blendSource != source || blendDestination != destination)) {
+      glBlendFunc(source, destination);
+      blendSource = source;
+      blendDestination = destination;
+    }
+  }
+
+  void GLState::setClearColour(const float r, const float g, const float b, const float a) {
+    if (change(clearColour[0] != r || clearColour[1] != g ||
+               clearColour[2] != b || clearColour[3] != a)) {
+      glClearColor(r, g, b, a);
+      clearColour[0] = r;
+      clearColour[1] = g;
+      clearColour[2] = b;
+      clearColour[3] = a;
+    }
+  }
+
+  void GLState::setDepthTest(const bool enabled) {
+    if (change(depthTest != (GLuint)enabled)) {
+      if (enabled) {
+        glEnable(GL_DEPTH_TEST);
+      }
+      else {
+        glDisable(GL_DEPTH_TEST);
+      }
+
+      depthTest = enabled;
+    }
+  }
+
+  void GLState::setDepthWrite(const bool enabled) {
+    if (change(depthWrite != (GLuint)enabled)) {
+      glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+      depthWrite = enabled;
+    }
+  }
+
+  void GLState::setViewport(const GLint x, const GLint y, const GLsizei width, const GLsizei height) {
+    if (change(viewport[0] != x || viewport[1] != y ||
+               viewport[2] != width || viewport[3] != height)) {
+      glViewport(x, y, width, height);
+      viewport[0] = x;
+      viewport[1] = y;
+      viewport[2] = width;
+      viewport[3] = height;
+    }
+  }
+
+  void GLState::deleteBuffer(const GLuint buffer) {
+    if (arrayBuffer == buffer) {
+      arrayBuffer = GLState::UNKNOWN;
+    }
+
+    glDeleteBuffers(1, &buffer);
+  }
+
+  void GLState::deleteFramebuffer(const GLuint framebuffer) {
+    if (this->framebuffer == framebuffer) {
+      this->framebuffer = GLState::UNKNOWN;
+    }
+
+    glDeleteFramebuffers(1, &framebuffer);
+  }
+
+  void GLState::deleteProgram(const GLuint program) {
+    if (this->program == program) {
+      this->program = GLState::UNKNOWN;
+    }
+
+    glDeleteProgram(program);
+  }
+
+  void GLState::deleteTexture(const GLuint texture) {
+    for (uint32_t i = 0; i < GLState::MAX_TEXTURE_UNITS; i++) {
+      if (textures[i] == texture) {
+        textures[i] = GLState::UNKNOWN;
+      }
+    }
+
+    glDeleteTextures(1, &texture);
+  }
+
+  void GLState::invalidate() {
+    activeTextureUnit = GLState::UNKNOWN;
+    arrayBuffer = GLState::UNKNOWN;
+    framebuffer = GLState::UNKNOWN;
+    program = GLState::UNKNOWN;
+    for (uint32_t i = 0; i < GLState::MAX_TEXTURE_UNITS; i++) {
+      textures[i] = GLState::UNKNOWN;
+    }
+    vertexArray = GLState::UNKNOWN;
+
+    //  NaN never compares equal, so the first colour always goes through.
+    blend = GLState::UNKNOWN;
+    for (uint32_t i = 0; i < 4; i++) {
+      blendColour[i] = NAN;
+    }
+    blendSource = GL_INVALID_ENUM;
+    blendDestination = GL_INVALID_ENUM;
+    for (uint32_t i = 0; i < 4; i++) {
+      clearColour[i] = NAN;
+    }
+    depthTest = GLState::UNKNOWN;
+    depthWrite = GLState::UNKNOWN;
+
+    //  No viewport is ever this size.
+    for (uint32_t i = 0; i < 4; i++) {
+      viewport[i] = -1;
+    }
+  }
+
+  void GLState::recordBufferUpload(const uint32_t bytes) {
+    if (statistics) {
+      statistics->bufferUploads++;
+      statistics->bufferUploadBytes += bytes;
+    }
+  }
+
+  void GLState::recordDraw(const uint32_t vertices) {
+    if (statistics) {
+      statistics->drawCalls++;
+      statistics->verticesSubmitted += vertices;
+    }
+  }
+
+  bool GLState::change(const bool needed) {
+    if (statistics) {
+      if (needed) {
+        statistics->stateChangesIssued++;
+      }
+      else {
+        statistics->stateChangesSkipped++;
+      }
+    }
+
+    return needed;
+  }
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#ifndef GLStateHPP
+#define GLStateHPP
+
+#include <cstdint>
+#include "Common.hpp"
+#include "FrameStatistics.hpp"
+
+namespace io {
+  /**
+   * Shadows the bits of GL state the game changes, and drops changes that
+   * wouldn't do anything.  GL is never queried; anything that touches these
+   * bits of state must go through here, or call invalidate() afterwards.
+   *
+   * Meshes, textures and fonts give their names back through here when
+   * they're deleted, so the instance has to be deleted after all of them,
+   * the ResourceManager's included.
+   */
+  class GLState {
+  public:
+    const static uint32_t MAX_TEXTURE_UNITS = 8;
+
+    static void deleteInstance() {
+      if (GLState::instance) {
+        delete GLState::instance;
+        GLState::instance = nullptr;
+      }
+    }
+
+    static GLState* getInstance() {
+      if (!GLState::instance) {
+        GLState::instance = new GLState();
+      }
+
+      return GLState::instance;
+    }
+
+    void bindArrayBuffer(const GLuint buffer);
+    void bindFramebuffer(const GLuint framebuffer);
+    void bindTexture(const GLuint texture, const uint32_t unit = 0);
+    void bindVertexArray(const GLuint vertexArray);
+    void useProgram(const GLuint program);
+
+    void setBlend(const bool enabled);
+    void setBlendColour(const float r, const float g, const float b, const float a);
+    void setBlendFunc(const GLenum source, const GLenum destination);
+    void setClearColour(const float r, const float g, const float b, const float a);
+    void setDepthTest(const bool enabled);
+    void setDepthWrite(const bool enabled);
+    void setViewport(const GLint x, const GLint y, const GLsizei width, const GLsizei height);
+
+    //  These delete the object, and forget it if it's currently bound, so
+    //  that a new object given the same name is still bound properly.
+    void deleteBuffer(const GLuint buffer);
+    void deleteFramebuffer(const GLuint framebuffer);
+    void deleteProgram(const GLuint program);
+    void deleteTexture(const GLuint texture);
+
+    //  Only meaningful once set through here, as GL isn't asked.
+    const float* getClearColour() const {
+      return clearColour;
+    }
+
+    GLuint getFramebuffer() const {
+      return framebuffer;
+    }
+
+    GLuint getProgram() const {
+      return program;
+    }
+
+    //  x, y, width and height, as with getClearColour().
+    const GLint* getViewport() const {
+      return viewport;
+    }
+
+    /**
+     * Forgets everything, so the next change to each bit of state is always
+     * made.  For after code that talks to GL directly.
+     */
+    void invalidate();
+
+    //  Counts draws and buffer uploads, which happen all over the place.
+    void recordBufferUpload(const uint32_t bytes);
+    void recordDraw(const uint32_t vertices);
+
+    //  Where issued and skipped changes are counted.  May be nullptr.
+    void setFrameStatistics(FrameStatistics* statistics) {
+      this->statistics = statistics;
+    }
+  private:
+    //  Stands in for state we know nothing about.
+    const static GLuint UNKNOWN = 0xFFFFFFFF;
+
+    static GLState* instance;
+
+    FrameStatistics* statistics;
+
+    GLuint activeTextureUnit;
+    GLuint arrayBuffer;
+    GLuint framebuffer;
+    GLuint program;
+    GLuint textures[GLState::MAX_TEXTURE_UNITS];
+    GLuint vertexArray;
+
+    GLuint blend;
+    float blendColour[4];
+    GLenum blendSource;
+    GLenum blendDestination;
+    float clearColour[4];
+    GLuint depthTest;
+    GLuint depthWrite;
+    GLint viewport[4];
+
+    GLState();
+    GLState(const GLState&);
+    GLState& operator=(const GLState&);
+
+    //  Counts the change, and returns whether it needs making.
+    bool change(const bool needed);
+  };
+}
+
+#endif // GLStateHPP
@@ -16,6 +16,7 @@
 #include "Game.hpp"
 #include "MazeState.hpp"
 #include "TownState.hpp"
+#include <chrono>
 
 namespace io {
   Game::Game() {
@@ -46,8 +47,12 @@ namespace io {
   }
   
   void Game::draw(Graphics* g) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
     currentState->draw(g);
     screenManager->draw(g);
+
+    g->getFrameStatistics().gameDrawMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
   }
 
   void Game::tick() {
@@ -0,0 +1,51 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#include "GlyphAtlas.hpp"
+#include "Log.hpp"
+
+namespace io {
+  GlyphAtlas::~GlyphAtlas() {
+    for (Texture* page : pages) {
+      delete page;
+    }
+    pages.clear();
+  }
+
+  bool GlyphAtlas::insert(const uint32_t w, const uint32_t h, const uint8_t* pixels, const int32_t pitch, uint32_t& page, uint32_t& x, uint32_t& y) {
+    if (!packer.pack(w + GlyphAtlas::PADDING, h + GlyphAtlas::PADDING, page, x, y)) {
+      return false;
+    }
+
+    if (page == pages.size()) {
+      Texture* texture = new Texture(GlyphAtlas::PAGE_SIZE, GlyphAtlas::PAGE_SIZE, TextureFormat::LUMINANCE);
+      texture->setSmooth(smooth);
+      pages.push_back(texture);
+      writeToLog(MessageLevel::INFO, "Added glyph atlas page %u (%u bytes in use).\n", page + 1, getMemoryUsed());
+    }
+
+    //  FreeType rows may be padded, or even stored bottom up.
+    std::vector<uint8_t> packedPixels(w * h);
+    for (uint32_t row = 0; row < h; row++) {
+      const uint8_t* source = (pitch >= 0) ? pixels + (row * pitch) : pixels + ((h - 1 - row) * -pitch);
+      for (uint32_t column = 0; column < w; column++) {
+        packedPixels[(row * w) + column] = source[column];
+      }
+    }
+
+    pages[page]->update(x, y, w, h, packedPixels.data());
+    return true;
+  }
+}
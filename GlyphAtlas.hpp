@@ -0,0 +1,77 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#ifndef GlyphAtlasHPP
+#define GlyphAtlasHPP
+
+#include <cstdint>
+#include <vector>
+#include "PagedShelfPacker.hpp"
+#include "Texture.hpp"
+
+namespace io {
+  /**
+   * Single channel pages of glyph coverage, packed on shelves.  A new page is
+   * added whenever the current ones are full, so any number of glyphs at any
+   * number of sizes can share one atlas.
+   */
+  class GlyphAtlas {
+  public:
+    const static uint32_t PAGE_SIZE = 512;
+
+    //  Smooth pages are filtered linearly, for glyphs drawn scaled.
+    GlyphAtlas(const bool smooth = false)
+      : packer(GlyphAtlas::PAGE_SIZE, GlyphAtlas::PAGE_SIZE), smooth(smooth) {
+    }
+
+    ~GlyphAtlas();
+
+    /**
+     * Copies a w x h coverage bitmap into the atlas, with rows pitch bytes
+     * apart.  The page it went on and where go in page, x and y.
+     */
+    bool insert(const uint32_t w, const uint32_t h, const uint8_t* pixels, const int32_t pitch, uint32_t& page, uint32_t& x, uint32_t& y);
+
+    //  Bytes of texture memory used by all of the pages.
+    uint32_t getMemoryUsed() const {
+      return pages.size() * GlyphAtlas::PAGE_SIZE * GlyphAtlas::PAGE_SIZE;
+    }
+
+    Texture* getPage(const uint32_t page) const {
+      if (page < pages.size()) {
+        return pages[page];
+      }
+
+      return nullptr;
+    }
+
+    uint32_t getPageCount() const {
+      return pages.size();
+    }
+  private:
+    //  Empty space left around each glyph, so that filtering doesn't pick up
+    //  its neighbours.
+    const static uint32_t PADDING = 1;
+
+    std::vector<Texture*> pages;
+    PagedShelfPacker packer;
+    bool smooth;
+
+    GlyphAtlas(const GlyphAtlas&);
+    GlyphAtlas& operator=(const GlyphAtlas&);
+  };
+}
+
+#endif // GlyphAtlasHPP
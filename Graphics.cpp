@@ -14,42 +14,84 @@
  *  limitations under the License.
 */
 #include "Graphics.hpp"
+#include <algorithm>
 #include <iostream>
+#include <chrono>
 #include <cmath>
+#include <cstdio>
+#include <initializer_list>
 #include "Common.hpp"
+#include "Log.hpp"
 #include "Utility.hpp"
 #include "ResourceManager.hpp"
+#include "FloorGeometry.hpp"
+#include "GLState.hpp"
 
 namespace io {
+  //  getWallTileAngle() of each side, in the order Facing lists them.  The
+  //  angles are right angles, so their sines and cosines are exact.
+  constexpr Matrix WALL_TILE_ROTATIONS[4] = {
+    Matrix::rotationY(0.0f, 1.0f),
+    Matrix::rotationY(1.0f, 0.0f),
+    Matrix::rotationY(0.0f, -1.0f),
+    Matrix::rotationY(-1.0f, 0.0f)
+  };
+
   Graphics::Graphics() {
 	glewExperimental = GL_TRUE;
     glewInit();
 
+    GLState* state = GLState::getInstance();
+    state->setFrameStatistics(&frameStatistics);
+
     glGenVertexArrays(1, &vertexArray);
-    glBindVertexArray(vertexArray);
+    state->bindVertexArray(vertexArray);
 
     glEnableVertexAttribArray(0);
     glEnableVertexAttribArray(1);
     glEnableVertexAttribArray(2);
 
-    fragShader = new FragmentShader("data/fragment.glsl");
-    vertShader = new VertexShader("data/vertex.glsl");
-    shaderProgram = new ShaderProgram();
-
-    shaderProgram->setFragmentShader(fragShader);
-    shaderProgram->setVertexShader(vertShader);
+    mapRenderMode = MapRenderMode::BAKED;
+    statisticsOverlayEnabled = false;
+    frameNumber = 0;
 
-    shaderProgram->addBinding(0, "inVertex");
-    shaderProgram->addBinding(1, "inTexCoord");
-    shaderProgram->addBinding(2, "inColour");
+    batchFragShader = new FragmentShader("data/batch.glsl");
 
-    shaderProgram->link();
-    shaderProgram->makeActive();
-
-    modelMatrixUniform = shaderProgram->getUniformLocation("inModelMatrix");
-    projectionMatrixUniform = shaderProgram->getUniformLocation("inProjectionMatrix");
-    viewMatrixUniform = shaderProgram->getUniformLocation("inViewMatrix");
-    texUniform = shaderProgram->getUniformLocation("inTexture");
+    vertShader = new VertexShader("data/vertex.glsl");
+    createPrograms();
+
+    sampleModeUniform = batchProgram->getUniformLocation("inSampleMode");
+    currentSampleMode = -1;
+    featuresUniform = meshVariants->getGeneric()->getUniformLocation("inFeatures");
+    currentFeatures = UINT32_MAX;
+    useProgram(meshVariants->getGeneric()->getProgramID());
+
+    //  The map is drawn with this from the first frame, so it's started now.
+    meshVariants->getProgram(ShaderFeatures::TEXTURED);
+
+    modelMatrixDirty = true;
+    projectionMatrixDirty = true;
+    viewMatrixDirty = true;
+
+    //  Everything that isn't an instanced draw sees an untransformed tile.
+    glVertexAttrib4f(3, 0.0f, 0.0f, 1.0f, 0.0f);
+
+    glGenBuffers(1, &instanceBuffer);
+    currentTexture = 0;
+    transientMeshesUsed = 0;
+    streamBuffer = new StreamBuffer(Graphics::STREAM_SECTION_SIZE);
+    spriteBatch = new SpriteBatch(streamBuffer);
+    batching = false;
+    activeQueue = &renderQueue;
+    activeTarget = nullptr;
+    renderTargetSupported = (GLEW_ARB_framebuffer_object == GL_TRUE);
+    if (!renderTargetSupported) {
+      writeToLog(MessageLevel::INFO, "Framebuffer objects not supported, screens will be drawn every frame.\n");
+    }
+    instancingSupported = (GLEW_ARB_instanced_arrays && GLEW_ARB_draw_instanced);
+    if (!instancingSupported) {
+      writeToLog(MessageLevel::INFO, "Instanced arrays not supported, instanced tiles will be drawn one at a time.\n");
+    }
 
     setMatrixMode(MatrixMode::MODEL);
     loadIdentity();
@@ -75,101 +117,773 @@ namespace io {
       //  Throw an error;
       throw std::runtime_error("Graphics::Graphics():  Could not load font.");
     }
+
+    //  The UI art is small enough to all go on one page.
+    uiAtlas = new TextureAtlas();
+    for (const char* filename : { "data/ui.png", "data/menu-item-left.png", "data/menu-item-centre.png", "data/menu-item-right.png" }) {
+      uiAtlas->add(filename);
+    }
   }
 
   Graphics::~Graphics() {
-    shaderProgram->makeInactive();
-    shaderProgram->unlink();
-    shaderProgram->setFragmentShader(nullptr);
-    shaderProgram->setVertexShader(nullptr);
+    batchProgram->makeInactive();
+    batchProgram->unlink();
+    batchProgram->setFragmentShader(nullptr);
+    batchProgram->setVertexShader(nullptr);
+    delete batchProgram;
+    delete meshVariants;
 
-    delete shaderProgram;
     delete vertShader;
-    delete fragShader;
+    delete batchFragShader;
+
+    //  These give their buffers and textures back to GLState, so they have
+    //  to go first.
+    delete spriteBatch;
+    delete streamBuffer;
+    delete uiAtlas;
+
+    GLState* state = GLState::getInstance();
+    state->deleteBuffer(instanceBuffer);
 
     glDisableVertexAttribArray(vertexArray);
-    glBindVertexArray(0);
+    state->bindVertexArray(0);
     glDeleteVertexArrays(1, &vertexArray);
     
     delete ceilingMesh;
     delete floorMesh;
     delete wallMesh;
+
+    for (Mesh* mesh : transientMeshes) {
+      delete mesh;
+    }
+    transientMeshes.clear();
+
+    state->setFrameStatistics(nullptr);
   }
 
-  void Graphics::drawCeilingTile(const int32_t x, const int32_t y, const uint32_t modelID) {
+  /**
+   * Uploads whichever matrices have changed since the last draw.  Anything
+   * that issues a draw call has to call this first.  Vertices are moved by
+   * the three matrices multiplied together here, once a draw rather than
+   * once a vertex, and the view and projection's product is kept between
+   * draws.  The separate matrices only go to programs that read them.
+   */
+  void Graphics::applyMatrices() {
+    if (viewMatrixDirty || projectionMatrixDirty) {
+      viewProjectionMatrix = projectionMatrix * viewMatrix;
+    }
+
+    if (modelMatrixDirty || viewMatrixDirty || projectionMatrixDirty) {
+      Matrix modelViewProjection = viewProjectionMatrix * modelMatrix;
+      glUniformMatrix4fv(modelViewProjectionMatrixUniform, 1, GL_FALSE, modelViewProjection.getData());
+      frameStatistics.matrixUploads++;
+    }
+
+    if (modelMatrixDirty && modelMatrixUniform >= 0) {
+      glUniformMatrix4fv(modelMatrixUniform, 1, GL_FALSE, modelMatrix.getData());
+      frameStatistics.matrixUploads++;
+    }
+
+    if (viewMatrixDirty && viewMatrixUniform >= 0) {
+      glUniformMatrix4fv(viewMatrixUniform, 1, GL_FALSE, viewMatrix.getData());
+      frameStatistics.matrixUploads++;
+    }
+
+    if (projectionMatrixDirty && projectionMatrixUniform >= 0) {
+      glUniformMatrix4fv(projectionMatrixUniform, 1, GL_FALSE, projectionMatrix.getData());
+      frameStatistics.matrixUploads++;
+    }
+
+    modelMatrixDirty = false;
+    viewMatrixDirty = false;
+    projectionMatrixDirty = false;
+  }
+
+  //  Links a fragment shader with the common vertex shader.
+  ShaderProgram* Graphics::createProgram(FragmentShader* fragmentShader, const std::string& cacheFilename) {
+    ShaderProgram* program = new ShaderProgram();
+
+    program->setFragmentShader(fragmentShader);
+    program->setVertexShader(vertShader);
+    program->setCacheFilename(cacheFilename);
+
+    program->addBinding(0, "inVertex");
+    program->addBinding(1, "inTexCoord");
+    program->addBinding(2, "inColour");
+    program->addBinding(3, "inInstance");
+
+    try {
+      program->link();
+    }
+    catch (std::exception& e) {
+      program->setFragmentShader(nullptr);
+      program->setVertexShader(nullptr);
+      delete program;
+      throw;
+    }
+
+    setUpProgram(program);
+    return program;
+  }
+
+  /**
+   * Builds every program from the shaders already loaded.  If one fails,
+   * none are left behind.  Linked programs are kept in the binary cache
+   * next to the shaders, so later runs can skip compiling them.
+   */
+  void Graphics::createPrograms() {
+    meshVariants = nullptr;
+    batchProgram = nullptr;
+    programUniforms.clear();
+
+    try {
+      //  The attributes go where createProgram() binds them.
+      meshVariants = new ShaderVariants("data/fragment.glsl", vertShader, { "inVertex", "inTexCoord", "inColour", "inInstance" }, "data/fragment");
+      setUpProgram(meshVariants->getGeneric());
+      batchProgram = createProgram(batchFragShader, "data/batch.program");
+    }
+    catch (std::exception& e) {
+      delete meshVariants;
+      meshVariants = nullptr;
+      throw;
+    }
+  }
+
+  uint32_t Graphics::getFeatures(const ShaderType shader) {
+    switch (shader) {
+    case ShaderType::DISTANCE_FIELD_TEXT:
+      return ShaderFeatures::DISTANCE_FIELD;
+    case ShaderType::COLOURED:
+      return ShaderFeatures::VERTEX_COLOUR;
+    case ShaderType::CUTOUT:
+      return ShaderFeatures::TEXTURED | ShaderFeatures::ALPHA_TEST;
+    default:
+      break;
+    }
+
+    return ShaderFeatures::TEXTURED;
+  }
+
+  /**
+   * The mesh program for features, or the generic variant if it isn't
+   * built yet.  Variants are set up the first time they're handed out.
+   */
+  GLuint Graphics::getProgram(const uint32_t features) {
+    ShaderProgram* program = meshVariants->getProgram(features);
+    if (programUniforms.count(program->getProgramID()) == 0) {
+      setUpProgram(program);
+    }
+
+    return program->getProgramID();
+  }
+
+  /**
+   * Points a linked program at texture unit 0, and notes where it keeps
+   * its matrices.  This can happen while commands are
+   * being queued, so the program in use is put back afterwards.
+   */
+  void Graphics::setUpProgram(ShaderProgram* program) {
+    GLState* state = GLState::getInstance();
+    GLuint previous = state->getProgram();
+    program->makeActive();
+
+    MatrixUniforms uniforms;
+    uniforms.modelMatrix = program->getUniformLocation("inModelMatrix");
+    uniforms.modelViewProjectionMatrix = program->getUniformLocation("inModelViewProjectionMatrix");
+    uniforms.projectionMatrix = program->getUniformLocation("inProjectionMatrix");
+    uniforms.viewMatrix = program->getUniformLocation("inViewMatrix");
+    programUniforms[program->getProgramID()] = uniforms;
+
+    //  Everything samples from texture unit 0, so this never changes.
+    texUniform = program->getUniformLocation("inTexture");
     glUniform1i(texUniform, 0);
 
+    state->useProgram(previous);
+  }
+
+  void Graphics::beginBatch() {
+    batching = true;
+  }
+
+  /**
+   * Everything in the batch is already in clip space, so it's drawn with
+   * identity matrices, and it doesn't matter what the matrices were when it
+   * was added.
+   */
+  void Graphics::endBatch() {
+    batching = false;
+
+    Matrix savedModel = modelMatrix;
+    Matrix savedView = viewMatrix;
+    Matrix savedProjection = projectionMatrix;
+    modelMatrix = Matrix::identity();
+    viewMatrix = Matrix::identity();
+    projectionMatrix = Matrix::identity();
+
+    for (uint32_t i = spriteBatch->getSealedRangeCount(); i < spriteBatch->getRangeCount(); i++) {
+      RenderCommand command;
+      command.batch = spriteBatch;
+      command.batchRange = i;
+      command.program = batchProgram->getProgramID();
+      command.texture = spriteBatch->getRange(i).texture;
+      command.blendMode = BlendMode::PREMULTIPLIED_ALPHA;
+      queueCommand(command, RenderPass::TRANSLUCENT, Vector3(0.0f, 0.0f, 0.0f));
+    }
+    spriteBatch->seal();
+
+    modelMatrix = savedModel;
+    viewMatrix = savedView;
+    projectionMatrix = savedProjection;
+  }
+
+  /**
+   * Finds what moves a vertex straight to clip space.  Only affine
+   * transforms can be applied on the CPU without a divide, which is all the
+   * 2D drawing ever uses.
+   */
+  bool Graphics::batchTransform(Matrix& transform) const {
+    transform = projectionMatrix * viewMatrix * modelMatrix;
+    return (transform.get(3, 0) == 0.0f && transform.get(3, 1) == 0.0f &&
+            transform.get(3, 2) == 0.0f && transform.get(3, 3) == 1.0f);
+  }
+
+  //  Quads are always batched, in a batch of their own if need be.
+  void Graphics::batchQuad(const GLuint texture, const SampleMode sampleMode, const float x, const float y, const float w, const float h,
+                           const float u0, const float v0, const float u1, const float v1, const Colour& colour) {
+    Matrix transform;
+    if (!batchTransform(transform)) {
+      return;
+    }
+
+    bool wasBatching = isBatching();
+    if (!wasBatching) {
+      beginBatch();
+    }
+
+    spriteBatch->addQuad(transform, x, y, w, h, u0, v0, u1, v1, texture, sampleMode, colour);
+    frameStatistics.batchedQuads++;
+
+    if (!wasBatching) {
+      endBatch();
+    }
+  }
+
+  void Graphics::beginRenderTarget(RenderTarget* target) {
+    if (isBatching()) {
+      endBatch();
+    }
+
+    activeTarget = target;
+    activeQueue = &targetQueue;
+  }
+
+  void Graphics::endRenderTarget() {
+    if (isBatching()) {
+      endBatch();
+    }
+
+    if (activeTarget && activeTarget->isComplete()) {
+      //  The clear colour and viewport belong to the screen, so they're put
+      //  back afterwards.  They come from GLState's shadows rather than
+      //  from GL, which would wait for the pipeline to drain.
+      GLState* state = GLState::getInstance();
+      GLuint framebuffer = state->getFramebuffer();
+      GLint viewport[4];
+      float clearColour[4];
+      std::copy(state->getViewport(), state->getViewport() + 4, viewport);
+      std::copy(state->getClearColour(), state->getClearColour() + 4, clearColour);
+
+      state->bindFramebuffer(activeTarget->getFramebufferID());
+      state->setViewport(0, 0, activeTarget->getWidth(), activeTarget->getHeight());
+      state->setClearColour(0.0f, 0.0f, 0.0f, 0.0f);
+      glClear(GL_COLOR_BUFFER_BIT);
+
+      submitQueue(targetQueue);
+
+      state->bindFramebuffer(framebuffer);
+      state->setViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+      state->setClearColour(clearColour[0], clearColour[1], clearColour[2], clearColour[3]);
+    }
+
+    targetQueue.clear();
+    activeQueue = &renderQueue;
+    activeTarget = nullptr;
+  }
+
+  void Graphics::beginFrame() {
+    frameNumber++;
+    frameStatistics.reset();
+
+    //  Variants that have finished building are drawn with from now on.
+    meshVariants->update();
+  }
+
+  /**
+   * Makes every draw queued this frame, in the order the render queue sorts
+   * them into.
+   */
+  void Graphics::endFrame() {
+    if (activeTarget) {
+      endRenderTarget();
+    }
+
+    if (isBatching()) {
+      endBatch();
+    }
+
+    if (isStatisticsOverlayEnabled()) {
+      queueStatisticsOverlay();
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    submitQueue(renderQueue);
+    frameStatistics.submitMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+
+    renderQueue.clear();
+    spriteBatch->clear();
+    streamBuffer->endFrame();
+    transientMeshesUsed = 0;
+
+    if (statisticsLog.is_open()) {
+      frameStatistics.writeCSV(statisticsLog);
+    }
+    lastFrameStatistics = frameStatistics;
+  }
+
+  void Graphics::drawCeilingTile(const int32_t x, const int32_t y, const uint32_t modelID) {
     pushMatrix();
     loadIdentity();
     translate(x * 16.0f, 0.0f, y * 16.0f);
 
     if (ceilingMesh) {
-      ceilingMesh->draw();
+      RenderCommand command;
+      command.mesh = ceilingMesh;
+      queueCommand(command, RenderPass::OPAQUE, Vector3(0.0f, 16.0f, 0.0f));
     }
 
     popMatrix();
   }
 
-  void Graphics::drawFloorTile(const int32_t x, const int32_t y, const uint32_t modelID) {
-    glUniform1i(texUniform, 0);
+  void Graphics::drawCeilingTiles(const std::vector<TileInstance>& instances) {
+    queueTileInstances(ceilingMesh, instances);
+  }
+
+  void Graphics::drawFloorGeometry(const std::vector<FloorGeometry*>& chunks, const int32_t x, const int32_t y) {
+    //  The geometry is in world space, so move the world so that the cell
+    //  (x, y) sits at the origin, the same as the per-tile path does.
+    pushMatrix();
+    loadIdentity();
+    translate(x * -16.0f, 0.0f, y * -16.0f);
+
+    for (const FloorGeometry* chunk : chunks) {
+      RenderCommand command;
+      command.geometry = chunk;
+      queueCommand(command, RenderPass::OPAQUE, chunk->getCentre());
+    }
+
+    popMatrix();
+  }
 
+  void Graphics::drawFloorTile(const int32_t x, const int32_t y, const uint32_t modelID) {
     pushMatrix();
     loadIdentity();
     translate(x * 16.0f, 0.0f, y * 16.0f);
 
     if (floorMesh) {
-      floorMesh->draw();
+      RenderCommand command;
+      command.mesh = floorMesh;
+      queueCommand(command, RenderPass::OPAQUE, Vector3(0.0f, 0.0f, 0.0f));
     }
 
     popMatrix();
   }
   
+  void Graphics::drawFloorTiles(const std::vector<TileInstance>& instances) {
+    queueTileInstances(floorMesh, instances);
+  }
+
+  void Graphics::drawMesh(const Mesh* mesh, const Texture* texture, const BlendMode blendMode, const Colour& blendColour, const ShaderType shader) {
+    if (!mesh) {
+      return;
+    }
+
+    GLuint textureID = texture ? texture->getTextureID() : currentTexture;
+    Matrix transform;
+    bool batchable = (shader == ShaderType::BASIC || shader == ShaderType::DISTANCE_FIELD_TEXT);
+    if (isBatching() && batchable && blendMode != BlendMode::OPAQUE && batchTransform(transform)) {
+      SampleMode sampleMode = SampleMode::IMAGE;
+      if (shader == ShaderType::DISTANCE_FIELD_TEXT) {
+        sampleMode = SampleMode::DISTANCE_FIELD;
+      }
+      else if (blendMode == BlendMode::CONSTANT_COLOUR) {
+        sampleMode = SampleMode::COVERAGE;
+      }
+
+      spriteBatch->addMesh(mesh, transform, textureID, sampleMode, blendColour);
+      frameStatistics.batchedQuads += mesh->getVertexCount() / 6;
+      return;
+    }
+
+    RenderCommand command;
+    command.mesh = mesh;
+    command.texture = textureID;
+    command.blendMode = blendMode;
+    command.blendColour = blendColour;
+    command.features = getFeatures(shader);
+
+    RenderPass pass = (blendMode == BlendMode::OPAQUE) ? RenderPass::OPAQUE : RenderPass::TRANSLUCENT;
+    queueCommand(command, pass, Vector3(0.0f, 0.0f, 0.0f));
+  }
+
   void Graphics::drawText(const std::string& text) {
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_CONSTANT_COLOR, GL_ONE_MINUS_SRC_COLOR);
-    font->drawText(text);
-    glDisable(GL_BLEND);
+    font->drawText(this, text);
   }
 
   void Graphics::drawQuad(float x, float y, float w, float h) {
-    glUniform1i(texUniform, 0);
-    
+    drawQuad(nullptr, x, y, w, h);
+  }
+
+  void Graphics::drawQuad(const Texture* texture, const float x, const float y, const float w, const float h, const Colour& colour) {
+    GLuint textureID = texture ? texture->getTextureID() : currentTexture;
+    batchQuad(textureID, SampleMode::IMAGE, x, y, w, h, 0.0f, 0.0f, 1.0f, 1.0f, colour);
+  }
+
+  void Graphics::drawRegion(const AtlasRegion* region, const float x, const float y, const float w, const float h, const Colour& colour) {
+    if (region) {
+      batchQuad(region->texture->getTextureID(), SampleMode::IMAGE, x, y, w, h, region->u0, region->v0, region->u1, region->v1, colour);
+    }
+  }
+
+  void Graphics::drawRenderTarget(const RenderTarget* target, const float x, const float y, const float w, const float h) {
+    if (target) {
+      batchQuad(target->getTexture()->getTextureID(), SampleMode::PREMULTIPLIED_IMAGE, x, y, w, h, 0.0f, 1.0f, 1.0f, 0.0f, Colour(255, 255, 255, 255));
+    }
+  }
+
+  void Graphics::drawWallTile(const int32_t x, const int32_t y, const Facing side, const uint32_t modelID) {
     pushMatrix();
     loadIdentity();
-    translate(x, y, 0);
+    translate(x * 16.0f, 0.0f, y * 16.0f);
+    setMatrix(getMatrix() * getWallTileRotation(side));
+    
+    if (wallMesh) {
+      RenderCommand command;
+      command.mesh = wallMesh;
+      queueCommand(command, RenderPass::OPAQUE, Vector3(8.0f, 8.0f, 0.0f));
+    }
     
     popMatrix();
   }
 
-  void Graphics::drawWallTile(const int32_t x, const int32_t y, const Facing side, const uint32_t modelID) {
-    glUniform1i(texUniform, 0);
+  void Graphics::drawWallTiles(const std::vector<TileInstance>& instances) {
+    queueTileInstances(wallMesh, instances);
+  }
 
+  Mesh* Graphics::getTransientMesh() {
+    if (transientMeshesUsed == transientMeshes.size()) {
+      Mesh* mesh = new Mesh();
+      mesh->setStreamBuffer(streamBuffer);
+      transientMeshes.push_back(mesh);
+    }
+
+    return transientMeshes[transientMeshesUsed++];
+  }
+
+  /**
+   * Fills in the state the command is drawn with, and queues it.  centre is
+   * the middle of what's being drawn, in model space, and decides where the
+   * command sorts.
+   */
+  void Graphics::queueCommand(RenderCommand& command, const RenderPass pass, const Vector3& centre) {
+    if (command.program == 0) {
+      command.program = getProgram(command.features);
+    }
+    if (command.texture == 0) {
+      command.texture = currentTexture;
+    }
+    command.modelMatrix = modelMatrix;
+    command.viewMatrix = viewMatrix;
+    command.projectionMatrix = projectionMatrix;
+
+    //  The camera looks down -z.
+    Vector3 eye = centre * (viewMatrix * modelMatrix);
+    activeQueue->push(command, pass, -eye.getZ());
+    frameStatistics.renderCommands++;
+  }
+
+  /**
+   * Lists the last frame's counters in the top left corner of the screen.
+   * The current frame's aren't complete until its draws have been made.
+   */
+  void Graphics::queueStatisticsOverlay() {
+    const FrameStatistics& stats = getLastFrameStatistics();
+    char lines[6][128];
+    snprintf(lines[0], sizeof(lines[0]), "draws %u  vertices %u  commands %u",
+             stats.drawCalls, stats.verticesSubmitted, stats.renderCommands);
+    snprintf(lines[1], sizeof(lines[1]), "matrices %u/%u  uniforms %u  binds %u  uploads %u (%u bytes)",
+             stats.matrixUploads, stats.matrixChanges, stats.uniformUploads, stats.textureBinds,
+             stats.bufferUploads, stats.bufferUploadBytes);
+    snprintf(lines[2], sizeof(lines[2]), "state changes %u  skipped %u",
+             stats.stateChangesIssued, stats.stateChangesSkipped);
+    snprintf(lines[3], sizeof(lines[3]), "cells %u/%u  chunks %u/%u",
+             stats.cellsSubmitted, stats.cellsTested, stats.chunksSubmitted,
+             stats.chunksTested);
+    snprintf(lines[4], sizeof(lines[4]), "game %.2fms  map %.2fms  submit %.2fms",
+             stats.gameDrawMicroseconds / 1000.0f, stats.mapDrawMicroseconds / 1000.0f,
+             stats.submitMicroseconds / 1000.0f);
+    snprintf(lines[5], sizeof(lines[5]), "batched draws %u  quads %u  screens redrawn %u",
+             stats.batchedDrawCalls, stats.batchedQuads, stats.screensRedrawn);
+
+    MatrixMode oldMode = getMatrixMode();
+
+    setMatrixMode(MatrixMode::VIEW);
     pushMatrix();
     loadIdentity();
-    translate(x * 16.0f, 0.0f, y * 16.0f);
 
+    setMatrixMode(MatrixMode::PROJECTION);
+    pushMatrix();
+    loadIdentity();
+    ortho(0, 640, 480, 0, 0, 1);
+
+    setMatrixMode(MatrixMode::MODEL);
+    pushMatrix();
+    loadIdentity();
+    translate(4.0f, 4.0f, 0.0f);
+
+    beginBatch();
+    for (const char* line : lines) {
+      font->drawText(this, line, Colour(255, 255, 0, 255));
+      translate(0.0f, font->getPixelSize() + 2.0f, 0.0f);
+    }
+    endBatch();
+
+    popMatrix();
+
+    setMatrixMode(MatrixMode::PROJECTION);
+    popMatrix();
+
+    setMatrixMode(MatrixMode::VIEW);
+    popMatrix();
+
+    setMatrixMode(oldMode);
+  }
+
+  void Graphics::queueTileInstances(const Mesh* mesh, const std::vector<TileInstance>& instances) {
+    if (!mesh || instances.size() == 0) {
+      return;
+    }
+
+    pushMatrix();
+    loadIdentity();
+
+    RenderCommand command;
+    command.mesh = mesh;
+    command.instances = &instances;
+    queueCommand(command, RenderPass::OPAQUE, Vector3(0.0f, 0.0f, 0.0f));
+
+    popMatrix();
+  }
+
+  void Graphics::submitCommand(const RenderCommand& command) {
+    GLState* state = GLState::getInstance();
+    useProgram(command.program);
+    state->bindTexture(command.texture);
+
+    //  The generic variant is told which features it's standing in for.
+    if (command.program == meshVariants->getGeneric()->getProgramID() && command.features != currentFeatures) {
+      float flags[4];
+      ShaderVariants::getFeatureFlags(command.features, flags);
+      glUniform4fv(featuresUniform, 1, flags);
+      currentFeatures = command.features;
+      frameStatistics.uniformUploads++;
+    }
+
+    switch (command.blendMode) {
+    case BlendMode::OPAQUE:
+      state->setBlend(false);
+      break;
+    case BlendMode::CONSTANT_COLOUR:
+      state->setBlend(true);
+      state->setBlendFunc(GL_CONSTANT_COLOR, GL_ONE_MINUS_SRC_COLOR);
+      state->setBlendColour(command.blendColour.getR() / 255.0f,
+                            command.blendColour.getG() / 255.0f,
+                            command.blendColour.getB() / 255.0f,
+                            command.blendColour.getA() / 255.0f);
+      break;
+    case BlendMode::PREMULTIPLIED_ALPHA:
+      state->setBlend(true);
+      state->setBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+      break;
+    }
+
+    //  Runs of commands usually share their view and projection, so only
+    //  the matrices that differ get marked for upload.
+    if (modelMatrix != command.modelMatrix) {
+      modelMatrix = command.modelMatrix;
+      modelMatrixDirty = true;
+    }
+
+    if (viewMatrix != command.viewMatrix) {
+      viewMatrix = command.viewMatrix;
+      viewMatrixDirty = true;
+    }
+
+    if (projectionMatrix != command.projectionMatrix) {
+      projectionMatrix = command.projectionMatrix;
+      projectionMatrixDirty = true;
+    }
+
+    applyMatrices();
+
+    if (command.batch) {
+      int32_t sampleMode = static_cast<int32_t>(command.batch->getRange(command.batchRange).sampleMode);
+      if (sampleMode != currentSampleMode) {
+        glUniform1f(sampleModeUniform, static_cast<float>(sampleMode));
+        currentSampleMode = sampleMode;
+        frameStatistics.uniformUploads++;
+      }
+
+      command.batch->draw(command.batchRange);
+      frameStatistics.batchedDrawCalls++;
+    }
+    else if (command.geometry) {
+      command.geometry->draw();
+    }
+    else if (command.instances) {
+      submitTileInstances(command.mesh, *command.instances);
+    }
+    else {
+      command.mesh->draw();
+    }
+  }
+
+  /**
+   * Makes every draw in a queue, in the order it sorts them into.  The
+   * matrices are put back afterwards, so that callers don't see the ones
+   * left behind by the last draw.
+   */
+  void Graphics::submitQueue(RenderQueue& queue) {
+    Matrix savedModel = modelMatrix;
+    Matrix savedView = viewMatrix;
+    Matrix savedProjection = projectionMatrix;
+
+    for (const std::pair<uint64_t, uint32_t>& entry : queue.sort()) {
+      submitCommand(queue.getCommand(entry.second));
+    }
+
+    modelMatrixDirty |= (modelMatrix != savedModel);
+    viewMatrixDirty |= (viewMatrix != savedView);
+    projectionMatrixDirty |= (projectionMatrix != savedProjection);
+    modelMatrix = savedModel;
+    viewMatrix = savedView;
+    projectionMatrix = savedProjection;
+  }
+
+  /**
+   * Places every instance with the inInstance attribute rather than the
+   * model matrix.  Without instanced arrays, the attribute is set once per
+   * tile instead, which still saves a matrix upload per tile.
+   */
+  void Graphics::submitTileInstances(const Mesh* mesh, const std::vector<TileInstance>& instances) {
+    if (isInstancingSupported()) {
+      //  If the stream is full, orphan the old contents of a buffer of our
+      //  own rather than waiting on draws still using them.
+      GLsizeiptr size = instances.size() * sizeof(TileInstance);
+      uint32_t offset = 0;
+      if (!streamBuffer->write(instances.data(), size, offset)) {
+        offset = 0;
+        GLState::getInstance()->bindArrayBuffer(instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, instances.data());
+        GLState::getInstance()->recordBufferUpload(size);
+      }
+
+      glEnableVertexAttribArray(3);
+      glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(TileInstance), (GLvoid*)(uintptr_t)offset);
+      glVertexAttribDivisorARB(3, 1);
+
+      mesh->drawInstanced(instances.size());
+
+      glVertexAttribDivisorARB(3, 0);
+      glDisableVertexAttribArray(3);
+    }
+    else {
+      for (const TileInstance& instance : instances) {
+        glVertexAttrib4f(3, instance.x, instance.z, instance.cosAngle, instance.sinAngle);
+        mesh->draw();
+      }
+    }
+
+    glVertexAttrib4f(3, 0.0f, 0.0f, 1.0f, 0.0f);
+  }
+
+  /**
+   * Each program keeps its own copy of the matrices it reads, so switching
+   * means uploading them again on the next draw.
+   */
+  void Graphics::useProgram(const GLuint program) {
+    GLState* state = GLState::getInstance();
+    if (state->getProgram() == program) {
+      return;
+    }
+
+    state->useProgram(program);
+
+    const MatrixUniforms& uniforms = programUniforms[program];
+    modelMatrixUniform = uniforms.modelMatrix;
+    modelViewProjectionMatrixUniform = uniforms.modelViewProjectionMatrix;
+    projectionMatrixUniform = uniforms.projectionMatrix;
+    viewMatrixUniform = uniforms.viewMatrix;
+
+    modelMatrixDirty = true;
+    if (uniforms.viewMatrix >= 0 || uniforms.projectionMatrix >= 0) {
+      projectionMatrixDirty = true;
+      viewMatrixDirty = true;
+    }
+  }
+
+  float Graphics::getWallTileAngle(const Facing side) {
     switch(side) {
     case Facing::SOUTH:
-      rotate(toRadians(270), 0.0f, 1.0f, 0.0f);
-      break;
+      return toRadians(270);
     case Facing::WEST:
-      rotate(toRadians(180), 0.0f, 1.0f, 0.0f);
-      break;
+      return toRadians(180);
     case Facing::NORTH:
-      rotate(toRadians(90), 0.0f, 1.0f, 0.0f);
-      break;
+      return toRadians(90);
     case Facing::EAST:
-      rotate(toRadians(0), 0.0f, 1.0f, 0.0f);
-      break;
+      return toRadians(0);
     default:
       break;
     }
-    
-    if (wallMesh) {
-      wallMesh->draw();
+
+    return 0.0f;
+  }
+
+  const Matrix& Graphics::getWallTileRotation(const Facing side) {
+    return WALL_TILE_ROTATIONS[static_cast<uint32_t>(side)];
+  }
+
+  bool Graphics::setStatisticsLog(const std::string& filename) {
+    if (statisticsLog.is_open()) {
+      statisticsLog.close();
     }
-    
-    popMatrix();
+
+    if (filename.empty()) {
+      return true;
+    }
+
+    statisticsLog.open(filename.c_str(), std::ios::out | std::ios::trunc);
+    if (!statisticsLog.is_open()) {
+      writeToLog(MessageLevel::WARNING, "Could not open statistics log \"%s\".\n", filename.c_str());
+      return false;
+    }
+
+    FrameStatistics::writeCSVHeader(statisticsLog);
+    return true;
+  }
+
+  void Graphics::setTexture(const Texture* texture) {
+    currentTexture = texture ? texture->getTextureID() : 0;
   }
 
   void Graphics::pushMatrix() {
@@ -196,15 +910,28 @@ namespace io {
   }
 
   void Graphics::translate(const float x, const float y, const float z) {
-    setMatrix(getMatrix() * Matrix::translation(x, y, z));
+    setMatrix(getMatrix().translated(x, y, z));
   }
 
+  //  A turn about one of the axes, which is all anything makes at the
+  //  moment, only changes two columns of the matrix.
   void Graphics::rotate(const float angle, const float x, const float y, const float z) {
-    setMatrix(getMatrix() * Matrix::rotation(angle, x, y, z));
+    if (x == 1.0f && y == 0.0f && z == 0.0f) {
+      setMatrix(getMatrix().rotatedX(::cos(angle), ::sin(angle)));
+    }
+    else if (x == 0.0f && y == 1.0f && z == 0.0f) {
+      setMatrix(getMatrix().rotatedY(::cos(angle), ::sin(angle)));
+    }
+    else if (x == 0.0f && y == 0.0f && z == 1.0f) {
+      setMatrix(getMatrix().rotatedZ(::cos(angle), ::sin(angle)));
+    }
+    else {
+      setMatrix(getMatrix() * Matrix::rotation(angle, x, y, z));
+    }
   }
 
   void Graphics::scale(const float x, const float y, const float z) {
-    setMatrix(getMatrix() * Matrix::scale(x, y, z));
+    setMatrix(getMatrix().scaled(x, y, z));
   }
 
   const Matrix& Graphics::getMatrix() const {
@@ -221,18 +948,21 @@ namespace io {
   }
 
   void Graphics::setMatrix(const Matrix& matrix) {
+    //  Nothing is uploaded until the next draw, see applyMatrices().
+    frameStatistics.matrixChanges++;
+
     switch(getMatrixMode()) {
     case MatrixMode::MODEL:
       modelMatrix = matrix;
-      glUniformMatrix4fv(modelMatrixUniform, 1, GL_FALSE, modelMatrix.getData());
+      modelMatrixDirty = true;
       break;
     case MatrixMode::VIEW:
       viewMatrix = matrix;
-      glUniformMatrix4fv(viewMatrixUniform, 1, GL_FALSE, viewMatrix.getData());
+      viewMatrixDirty = true;
       break;
     case MatrixMode::PROJECTION:
       projectionMatrix = matrix;
-      glUniformMatrix4fv(projectionMatrixUniform, 1, GL_FALSE, projectionMatrix.getData());
+      projectionMatrixDirty = true;
       break;
     }
   }
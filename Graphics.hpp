@@ -17,8 +17,11 @@
 #define GraphicsHPP
 
 #include <cstdint>
+#include <fstream>
 #include <stack>
 #include <string>
+#include <unordered_map>
+#include <vector>
 #include "Font.hpp"
 #include "Mesh.hpp"
 #include "Matrix.hpp"
@@ -26,39 +29,205 @@
 #include "FragmentShader.hpp"
 #include "VertexShader.hpp"
 #include "ShaderProgram.hpp"
+#include "ShaderVariants.hpp"
 #include "OBJModel.hpp"
 #include "BoundingBox.hpp"
+#include "FrameStatistics.hpp"
+#include "RenderQueue.hpp"
+#include "RenderTarget.hpp"
+#include "SpriteBatch.hpp"
+#include "TextureAtlas.hpp"
+#include "TileInstance.hpp"
 
 namespace io {
+  class FloorGeometry;
+
   enum class MatrixMode : uint8_t {
     MODEL,
     VIEW,
     PROJECTION
   };
 
+  /**
+   * Selects how a Map submits its geometry.  PER_TILE draws every visible
+   * tile with its own transform and draw call, BAKED draws the floor's
+   * pre-built world space geometry, and INSTANCED draws each kind of tile
+   * in one instanced call.  PER_TILE is kept for comparison.
+   */
+  enum class MapRenderMode : uint8_t {
+    PER_TILE,
+    BAKED,
+    INSTANCED
+  };
+
+  /**
+   * The programs a mesh can be drawn with, each a variant of
+   * data/fragment.glsl.  BASIC draws the texture.  DISTANCE_FIELD_TEXT reads
+   * the texture as a signed distance field rather than colour.  COLOURED
+   * draws the vertex colours without sampling a texture at all, and CUTOUT
+   * draws the texture, leaving out what's less than half opaque.
+   */
+  enum class ShaderType : uint8_t {
+    BASIC,
+    DISTANCE_FIELD_TEXT,
+    COLOURED,
+    CUTOUT
+  };
+
   class Graphics {
   public:
     Graphics();
     ~Graphics();
 
+    void beginFrame();
+    void endFrame();
+
+    /**
+     * Between these, translucent meshes and quads go into the sprite batch
+     * rather than being queued one at a time.  endBatch() queues a draw for
+     * each run of them that shares a texture, in the order they came in.
+     */
+    void beginBatch();
+    void endBatch();
+
+    /**
+     * Draws made between these go into target rather than the screen.  They
+     * are queued and sorted as usual, but made straight away by
+     * endRenderTarget(), which clears the target to transparent first.
+     * Targets can't be nested.  The screen's framebuffer, viewport and
+     * clear colour are put back from GLState, so they have to have been
+     * set through it.
+     */
+    void beginRenderTarget(RenderTarget* target);
+    void endRenderTarget();
+
     void drawCeilingTile(const int32_t x, const int32_t y, const uint32_t modelID);
+    void drawCeilingTiles(const std::vector<TileInstance>& instances);
+    void drawFloorGeometry(const std::vector<FloorGeometry*>& chunks, const int32_t x, const int32_t y);
     void drawFloorTile(const int32_t x, const int32_t y, const uint32_t modelID);
+    void drawFloorTiles(const std::vector<TileInstance>& instances);
+
+    /**
+     * Queues a mesh to be drawn with the current matrices.  If texture is
+     * nullptr, the texture set with setTexture() is used.
+     */
+    void drawMesh(const Mesh* mesh, const Texture* texture, const BlendMode blendMode, const Colour& blendColour = Colour(255, 255, 255, 255), const ShaderType shader = ShaderType::BASIC);
     void drawText(const std::string& text);
+    //  Draws the texture set with setTexture() over the rectangle.
     void drawQuad(float x, float y, float w, float h);
+    void drawQuad(const Texture* texture, const float x, const float y, const float w, const float h, const Colour& colour = Colour(255, 255, 255, 255));
+
+    //  Draws an image from an atlas, stretched over the rectangle.
+    void drawRegion(const AtlasRegion* region, const float x, const float y, const float w, const float h, const Colour& colour = Colour(255, 255, 255, 255));
+
+    //  Draws what was drawn into a render target, the right way up.
+    void drawRenderTarget(const RenderTarget* target, const float x, const float y, const float w, const float h);
     void drawWallTile(const int32_t x, const int32_t y, const Facing side, const uint32_t modelID);
+    void drawWallTiles(const std::vector<TileInstance>& instances);
+
+    const Mesh* getCeilingMesh() const {
+      return ceilingMesh;
+    }
+
+    const Mesh* getFloorMesh() const {
+      return floorMesh;
+    }
+
+    //  Counts up by one for every beginFrame().
+    uint32_t getFrameNumber() const {
+      return frameNumber;
+    }
+
+    FrameStatistics& getFrameStatistics() {
+      return frameStatistics;
+    }
+
+    //  The counters of the last frame to be finished by endFrame().
+    const FrameStatistics& getLastFrameStatistics() const {
+      return lastFrameStatistics;
+    }
+
+    MapRenderMode getMapRenderMode() const {
+      return mapRenderMode;
+    }
 
     MatrixMode getMatrixMode() const {
       return matrixMode;
     }
 
+    const Matrix& getProjectionMatrix() const {
+      return projectionMatrix;
+    }
+
+    const Matrix& getViewMatrix() const {
+      return viewMatrix;
+    }
+
+    /**
+     * Returns a mesh to fill and hand to drawMesh().  It belongs to Graphics,
+     * and is only good until the end of the frame.  Its vertices are
+     * written to the stream buffer.
+     */
+    Mesh* getTransientMesh();
+
+    const Mesh* getWallMesh() const {
+      return wallMesh;
+    }
+
+    static float getWallTileAngle(const Facing side);
+
+    //  A turn by getWallTileAngle() about the y axis, made by the compiler.
+    static const Matrix& getWallTileRotation(const Facing side);
+
+    /**
+     * The atlas that UI images are packed into.  Drawing from it rather than
+     * from separate textures lets all of a screen's chrome share a batch.
+     */
+    TextureAtlas& getUIAtlas() {
+      return *uiAtlas;
+    }
+
+    bool isBatching() const {
+      return batching;
+    }
+
+    bool isInstancingSupported() const {
+      return instancingSupported;
+    }
+
+    bool isRenderTargetSupported() const {
+      return renderTargetSupported;
+    }
+
+    bool isStatisticsOverlayEnabled() const {
+      return statisticsOverlayEnabled;
+    }
+
     BoundingBox getTextBoundingBox(const std::string& text) {
       return font->getTextBoundingBox(text);
     }
 
+    void setMapRenderMode(const MapRenderMode mode) {
+      mapRenderMode = mode;
+    }
+
     void setMatrixMode(const MatrixMode mode) {
       matrixMode = mode;
     }
 
+    /**
+     * Appends the statistics of every frame to a CSV file from now on.  An
+     * empty filename stops logging.
+     */
+    bool setStatisticsLog(const std::string& filename);
+
+    void setStatisticsOverlayEnabled(const bool enabled) {
+      statisticsOverlayEnabled = enabled;
+    }
+
+    //  The texture that the map tiles are drawn with.
+    void setTexture(const Texture* texture);
+
     void pushMatrix();
     void popMatrix();
     void loadIdentity();
@@ -68,31 +237,99 @@ namespace io {
     void rotate(const float angle, const float x, const float y, const float z);
     void scale(const float x, const float y, const float z);
   private:
+    //  Bytes of streamed data a frame can use before the stream has to grow.
+    const static uint32_t STREAM_SECTION_SIZE = 1024 * 1024;
+
+    FrameStatistics frameStatistics;
+    FrameStatistics lastFrameStatistics;
+    uint32_t frameNumber;
+    bool statisticsOverlayEnabled;
+    std::ofstream statisticsLog;
+    MapRenderMode mapRenderMode;
     MatrixMode matrixMode;
     std::stack<Matrix> matrixStack;
     
     GLuint vertexArray;
     GLuint texUniform;
 
-    FragmentShader* fragShader;
+    GLuint instanceBuffer;
+    bool instancingSupported;
+
+    RenderQueue renderQueue;
+    RenderQueue targetQueue;
+    RenderQueue* activeQueue;
+    RenderTarget* activeTarget;
+    bool renderTargetSupported;
+    GLuint currentTexture;
+    std::vector<Mesh*> transientMeshes;
+    uint32_t transientMeshesUsed;
+
+    //  Vertices and instances that only last for the frame go in here.
+    StreamBuffer* streamBuffer;
+
+    SpriteBatch* spriteBatch;
+    bool batching;
+    TextureAtlas* uiAtlas;
+
+    //  Where a program keeps the matrices, or -1 for those it doesn't read.
+    struct MatrixUniforms {
+      GLint modelMatrix;
+      GLint modelViewProjectionMatrix;
+      GLint projectionMatrix;
+      GLint viewMatrix;
+    };
+
     VertexShader* vertShader;
-    ShaderProgram* shaderProgram;
+    std::unordered_map<GLuint, MatrixUniforms> programUniforms;
+
+    //  Meshes are drawn with variants of one shader, see ShaderType.
+    ShaderVariants* meshVariants;
+    GLint featuresUniform;
+    uint32_t currentFeatures;
+
+    FragmentShader* batchFragShader;
+    ShaderProgram* batchProgram;
+    GLint sampleModeUniform;
+    int32_t currentSampleMode;
 
     Mesh* floorMesh;
     Mesh* wallMesh;
     Mesh* ceilingMesh;
 
     Matrix modelMatrix;
-    GLuint modelMatrixUniform;
+    GLint modelMatrixUniform;
+    bool modelMatrixDirty;
 
     Matrix projectionMatrix;
-    GLuint projectionMatrixUniform;
+    GLint projectionMatrixUniform;
+    bool projectionMatrixDirty;
 
     Matrix viewMatrix;
-    GLuint viewMatrixUniform;
+    GLint viewMatrixUniform;
+    bool viewMatrixDirty;
+
+    //  Worked out in applyMatrices().
+    Matrix viewProjectionMatrix;
+    GLint modelViewProjectionMatrixUniform;
     
     Font* font;
     
+    void applyMatrices();
+    bool batchTransform(Matrix& transform) const;
+    void batchQuad(const GLuint texture, const SampleMode sampleMode, const float x, const float y, const float w, const float h,
+                   const float u0, const float v0, const float u1, const float v1, const Colour& colour);
+    ShaderProgram* createProgram(FragmentShader* fragmentShader, const std::string& cacheFilename);
+    void createPrograms();
+    static uint32_t getFeatures(const ShaderType shader);
+    GLuint getProgram(const uint32_t features);
+    void queueCommand(RenderCommand& command, const RenderPass pass, const Vector3& centre);
+    void queueStatisticsOverlay();
+    void queueTileInstances(const Mesh* mesh, const std::vector<TileInstance>& instances);
+    void setUpProgram(ShaderProgram* program);
+    void submitCommand(const RenderCommand& command);
+    void submitQueue(RenderQueue& queue);
+    void submitTileInstances(const Mesh* mesh, const std::vector<TileInstance>& instances);
+    void useProgram(const GLuint program);
     const Matrix& getMatrix() const;
     void setMatrix(const Matrix& toApply);
   };
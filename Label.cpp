@@ -21,7 +21,7 @@
 namespace io {
   Label::Label() {
     ResourceManager* rm = ResourceManager::getInstance();
-    font = rm->getResource("data/DejaVuSansMono.ttf")->toFont();
+    layout.setFont(rm->getResource("data/DejaVuSansMono.ttf")->toFont());
     horizontalAlignment = HAlign::LEFT;
     verticalAlignment = VAlign::TOP;
   }
@@ -29,7 +29,7 @@ namespace io {
   void Label::render(Graphics* g) {
     Font *f = getFont();
     if (f) {
-      BoundingBox box = f->getTextBoundingBox(getText());
+      BoundingBox box = layout.getBoundingBox();
 
       float xOffset = 0.0f;
       float yOffset = 0.0f;
@@ -59,7 +59,7 @@ namespace io {
       }
 
       g->translate(xOffset, yOffset, 0.0f);
-      f->drawText(getText(), Colour(127, 0, 255, 255));
+      layout.draw(g, Colour(127, 0, 255, 255));
     }
   }
 }
@@ -19,6 +19,7 @@
 #include "Font.hpp"
 #include "Component.hpp"
 #include "Graphics.hpp"
+#include "TextLayout.hpp"
 #include <string>
 
 namespace io {
@@ -42,7 +43,7 @@ namespace io {
     }
     
     Font* getFont() const {
-      return font;
+      return layout.getFont();
     }
 
     HAlign getHorizontalAlignment() const {
@@ -50,7 +51,7 @@ namespace io {
     }
     
     std::string getText() const {
-      return text;
+      return layout.getText();
     }
     
     VAlign getVerticalAlignment() const {
@@ -58,23 +59,30 @@ namespace io {
     }
     
     void setFont(Font* font) {
-      this->font = font;
+      if (font != layout.getFont()) {
+        layout.setFont(font);
+        invalidate();
+      }
     }
 
     void setHorizontalAlignment(const HAlign horizontalAlignment) {
       this->horizontalAlignment = horizontalAlignment;
+      invalidate();
     }
     
     void setText(const std::string& text) {
-      this->text = text;
+      if (text != layout.getText()) {
+        layout.setText(text);
+        invalidate();
+      }
     }
     
     void setVerticalAlignment(const VAlign verticalAlignment) {
       this->verticalAlignment = verticalAlignment;
+      invalidate();
     }
   private:
-    Font* font;
-    std::string text;
+    TextLayout layout;
     
     HAlign horizontalAlignment;
     VAlign verticalAlignment;
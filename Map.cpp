@@ -17,6 +17,11 @@
 #include "ResourceManager.hpp"
 #include "tinyxml2.h"
 #include "Log.hpp"
+#include "Utility.hpp"
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include <chrono>
+#include <cmath>
 #include <exception>
 #include <stdexcept>
 
@@ -25,6 +30,12 @@ using namespace tinyxml2;
 namespace io {
   const int32_t MAX_DISTANCE = 64;
 
+  void clipWindowToFacing(const Facing facing, int32_t& minX, int32_t& maxX,
+                          int32_t& minY, int32_t& maxY);
+  bool isCellBoxVisible(const ViewFrustum& frustum, const int32_t minX,
+                        const int32_t maxX, const int32_t minY,
+                        const int32_t maxY);
+
   Map* Map::mapFromXML(const std::string& filename) {
     writeToLog(MessageLevel::INFO, "Loading map from file \"%s\"\n", filename.c_str());
 
@@ -218,6 +229,8 @@ namespace io {
         else {
           writeToLog(MessageLevel::WARNING, "Map::mapFromXML():  Missing objects element.  Possibly a mistake?");
         }
+
+        newMap->loadPotentiallyVisibleSet(Map::getPotentiallyVisibleSetFilename(filename));
       }
       else {
         writeToLog(MessageLevel::ERROR, "Map::mapFromXML():  Error parsing floor file.");
@@ -235,6 +248,31 @@ namespace io {
     return newMap;
   }
 
+  std::string Map::getPotentiallyVisibleSetFilename(const std::string& floorFilename) {
+    return boost::filesystem::path(floorFilename).replace_extension(".pvs").string();
+  }
+
+  /**
+   * Uses the visibility set saved next to the floor file.  Building one
+   * takes far too long to do while loading, so it's left to PVSBuilder in
+   * tools/, and floors without an up to date set cast rays instead.
+   */
+  void Map::loadPotentiallyVisibleSet(const std::string& filename) {
+    PotentiallyVisibleSet* newPVS = nullptr;
+    if (boost::filesystem::exists(filename)) {
+      newPVS = PotentiallyVisibleSet::load(filename, this);
+    }
+
+    if (newPVS) {
+      writeToLog(MessageLevel::INFO, "Loaded PVS from \"%s\" (%u bytes).\n", filename.c_str(), newPVS->getEncodedSize());
+    }
+    else {
+      writeToLog(MessageLevel::INFO, "No usable PVS at \"%s\", falling back to raycast visibility.\n", filename.c_str());
+    }
+
+    setPotentiallyVisibleSet(newPVS);
+  }
+
   Map* Map::mapFromImage(const std::string& filename) {
     Colour unfilled(200, 200, 250, 255);
 
@@ -271,47 +309,459 @@ namespace io {
     return newMap;
   }
   
-  void Map::draw(Graphics* g, const int32_t cx, const int32_t cy) {
-    for (int32_t y = -MAX_DISTANCE; y < MAX_DISTANCE; y++) {
-      for (int32_t x = -MAX_DISTANCE; x < MAX_DISTANCE; x++) {
-        if (!isSolid(cx + x, cy + y)) {
-          g->drawFloorTile(x, y, getCell(cx + x, cy + y)->getFloor());
-          g->drawCeilingTile(x, y, getCell(cx + x, cy + y)->getCeiling());
-
-          /*
-           * Remember, the get*Wall() methods return the wall you'd see if you
-           * were facing the cell from that direction.  If we're to the east
-           * of the current cell, and facing it(We're facing west), we want
-           * the EAST wall of the cell.
-           */
-
-          uint8_t wallID;
-          if (isSolid(cx + x, cy + y - 1)) {
-            wallID = getCell(cx + x, cy + y - 1)->getSouthWall();
-            g->drawWallTile(x, y, Facing::NORTH, wallID);
-          }
+  /**
+   * Bakes the open cells of every dirty chunk into world space geometry,
+   * using the tile meshes owned by the graphics object.  Cell (x, y) ends up
+   * at (x * 16, 0, y * 16), which is where the per-tile path would draw it if
+   * the player were standing at (0, 0).
+   */
+  void Map::bakeGeometry(Graphics* g) {
+    for (int32_t chunkY = 0; chunkY < chunksHigh; chunkY++) {
+      for (int32_t chunkX = 0; chunkX < chunksWide; chunkX++) {
+        if (getChunk(chunkX, chunkY)->isDirty()) {
+          bakeChunk(g, chunkX, chunkY);
+        }
+      }
+    }
+  }
 
-          if (isSolid(cx + x + 1, cy + y)) {
-            wallID = getCell(cx + x + 1, cy + y)->getWestWall();
-            g->drawWallTile(x, y, Facing::EAST, wallID);
+  void Map::bakeChunk(Graphics* g, const int32_t chunkX, const int32_t chunkY) {
+    FloorGeometry* chunk = getChunk(chunkX, chunkY);
+    chunk->begin();
+
+    int32_t startX = chunkX * CHUNK_SIZE;
+    int32_t startY = chunkY * CHUNK_SIZE;
+    for (int32_t y = startY; y < startY + CHUNK_SIZE && y < getHeight(); y++) {
+      for (int32_t x = startX; x < startX + CHUNK_SIZE && x < getWidth(); x++) {
+        if (!isSolid(x, y)) {
+          Matrix cellTransform = Matrix::translation(x * 16.0f, 0.0f, y * 16.0f);
+          chunk->beginCell(getChunkCellIndex(x, y));
+          chunk->addFloorTile(g->getFloorMesh(), cellTransform);
+          chunk->addCeilingTile(g->getCeilingMesh(), cellTransform);
+
+          //  Same rules as in drawCell().
+          if (isSolid(x, y - 1)) {
+            chunk->addWallTile(g->getWallMesh(), cellTransform * Graphics::getWallTileRotation(Facing::NORTH));
           }
 
-          if (isSolid(cx + x, cy + y + 1)) {
-            wallID = getCell(cx + x, cy + y + 1)->getNorthWall();
-            g->drawWallTile(x, y, Facing::SOUTH, wallID);
+          if (isSolid(x + 1, y)) {
+            chunk->addWallTile(g->getWallMesh(), cellTransform * Graphics::getWallTileRotation(Facing::EAST));
           }
 
-          if (isSolid(cx + x - 1, cy + y)) {
-            wallID = getCell(cx + x - 1, cy + y)->getEastWall();
-            g->drawWallTile(x, y, Facing::WEST, wallID);
+          if (isSolid(x, y + 1)) {
+            chunk->addWallTile(g->getWallMesh(), cellTransform * Graphics::getWallTileRotation(Facing::SOUTH));
           }
-          
-          Activatable* act = getActivatable(cx + x, cy + y);
-          if (act) {
-            act->draw(g);
+
+          if (isSolid(x - 1, y)) {
+            chunk->addWallTile(g->getWallMesh(), cellTransform * Graphics::getWallTileRotation(Facing::WEST));
           }
+          chunk->endCell();
         }
       }
     }
+
+    chunk->end();
+  }
+
+  /**
+   * Works out which cells can be seen from the centre of cell (x, y) when
+   * looking in the given direction.  Rays are fanned out over the half of the
+   * map in front of the player, and stop at the first solid cell they hit or
+   * after MAX_DISTANCE cells.  The player's cell is always visible.
+   */
+  void Map::computeVisibility(CellVisibility* out, const int32_t x, const int32_t y, const Facing facing) {
+    out->clear();
+    if (isSolid(x, y)) {
+      return;
+    }
+
+    out->markVisible(x, y);
+
+    float facingAngle = 0.0f;
+    switch (facing) {
+    case Facing::NORTH:
+      facingAngle = -M_PI / 2.0f;
+      break;
+    case Facing::EAST:
+      facingAngle = 0.0f;
+      break;
+    case Facing::SOUTH:
+      facingAngle = M_PI / 2.0f;
+      break;
+    case Facing::WEST:
+      facingAngle = M_PI;
+      break;
+    }
+
+    for (uint32_t i = 0; i < Map::VISIBILITY_RAY_COUNT; i++) {
+      float angle = facingAngle - (M_PI / 2.0f) + ((M_PI * i) / (Map::VISIBILITY_RAY_COUNT - 1));
+      castVisibilityRay(out, x, y, ::cos(angle), ::sin(angle));
+    }
+  }
+
+  /**
+   * Walks a ray from the centre of cell (x, y) through the grid one cell
+   * boundary at a time, marking every open cell it passes through.
+   */
+  void Map::castVisibilityRay(CellVisibility* out, const int32_t x, const int32_t y, const float dirX, const float dirY) {
+    int32_t cellX = x;
+    int32_t cellY = y;
+    int32_t stepX = (dirX < 0.0f) ? -1 : 1;
+    int32_t stepY = (dirY < 0.0f) ? -1 : 1;
+
+    //  How far along the ray it takes to cross one cell on each axis, and how
+    //  far it is to the next boundary on each axis.
+    float deltaX = (dirX != 0.0f) ? ::fabs(1.0f / dirX) : MAX_DISTANCE * 2.0f;
+    float deltaY = (dirY != 0.0f) ? ::fabs(1.0f / dirY) : MAX_DISTANCE * 2.0f;
+    float nextX = deltaX * 0.5f;
+    float nextY = deltaY * 0.5f;
+
+    while (true) {
+      float distance = 0.0f;
+      if (nextX < nextY) {
+        distance = nextX;
+        nextX += deltaX;
+        cellX += stepX;
+      }
+      else {
+        distance = nextY;
+        nextY += deltaY;
+        cellY += stepY;
+      }
+
+      if (distance > MAX_DISTANCE || isSolid(cellX, cellY)) {
+        break;
+      }
+
+      out->markVisible(cellX, cellY);
+    }
+  }
+
+  void Map::clearVisibilityCache() {
+    for (std::pair<uint32_t, CellVisibility*> entry : visibilityCache) {
+      delete entry.second;
+    }
+
+    visibilityCache.clear();
+    visibilityCacheOrder.clear();
+  }
+
+  uint32_t Map::getLayoutHash() {
+    if (layoutHashDirty) {
+      layoutHash = PotentiallyVisibleSet::hashMap(this);
+      layoutHashDirty = false;
+    }
+
+    return layoutHash;
+  }
+
+  const CellVisibility* Map::getVisibility(const int32_t x, const int32_t y, const Facing facing) {
+    if (!getCell(x, y)) {
+      return nullptr;
+    }
+
+    if (pvsUnchecked) {
+      pvsUnchecked = false;
+      if (!pvs->isBuiltFor(this)) {
+        writeToLog(MessageLevel::INFO, "Map layout changed, falling back to raycast visibility.\n");
+        setPotentiallyVisibleSet(nullptr);
+      }
+    }
+
+    uint32_t key = (((y * getWidth()) + x) << 2) | static_cast<uint32_t>(facing);
+    if (visibilityCache.count(key) > 0) {
+      return visibilityCache.at(key);
+    }
+
+    //  Recycle the oldest entry once the cache is full.
+    CellVisibility* visibility = nullptr;
+    if (visibilityCache.size() >= Map::VISIBILITY_CACHE_SIZE) {
+      uint32_t oldest = visibilityCacheOrder.front();
+      visibilityCacheOrder.pop_front();
+      visibility = visibilityCache.at(oldest);
+      visibilityCache.erase(oldest);
+    }
+    else {
+      visibility = new CellVisibility(getWidth(), getHeight());
+    }
+
+    if (pvs) {
+      pvs->decode(visibility, x, y, facing);
+    }
+    else {
+      computeVisibility(visibility, x, y, facing);
+    }
+    visibilityCache[key] = visibility;
+    visibilityCacheOrder.push_back(key);
+
+    return visibility;
+  }
+
+  void Map::draw(Graphics* g, const int32_t cx, const int32_t cy, const Facing facing) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    const CellVisibility* visibility = getVisibility(cx, cy, facing);
+    if (!visibility) {
+      return;
+    }
+
+    //  Cells are culled relative to the player, which is how the per-tile
+    //  path positions them, so the model matrix doesn't come into it.
+    ViewFrustum frustum(g->getProjectionMatrix() * g->getViewMatrix());
+
+    switch (g->getMapRenderMode()) {
+    case MapRenderMode::BAKED:
+      bakeGeometry(g);
+      cullChunks(g, frustum, visibility, cx, cy, facing);
+      g->drawFloorGeometry(visibleChunks, cx, cy);
+      drawActivatables(g, visibility);
+      break;
+    case MapRenderMode::INSTANCED:
+      cullCells(g, frustum, visibility, cx, cy, facing);
+      drawTileInstances(g, cx, cy);
+      break;
+    case MapRenderMode::PER_TILE:
+      cullCells(g, frustum, visibility, cx, cy, facing);
+      drawTiles(g, cx, cy);
+      break;
+    }
+
+    g->getFrameStatistics().mapDrawMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  void Map::cullChunks(Graphics* g, const ViewFrustum& frustum, const CellVisibility* visibility, const int32_t cx, const int32_t cy, const Facing facing) {
+    FrameStatistics& stats = g->getFrameStatistics();
+    visibleChunks.clear();
+
+    //  Hand each chunk the cells of it that can be seen.
+    for (FloorGeometry* chunk : chunks) {
+      chunk->clearVisibleCells();
+    }
+
+    stats.cellsTested += visibility->getVisibleCells().size();
+    for (uint32_t cell : visibility->getVisibleCells()) {
+      int32_t x = cell % getWidth();
+      int32_t y = cell / getWidth();
+      getChunk(x / CHUNK_SIZE, y / CHUNK_SIZE)->addVisibleCell(getChunkCellIndex(x, y));
+    }
+
+    for (int32_t chunkY = 0; chunkY < chunksHigh; chunkY++) {
+      for (int32_t chunkX = 0; chunkX < chunksWide; chunkX++) {
+        FloorGeometry* chunk = getChunk(chunkX, chunkY);
+        stats.chunksTested++;
+
+        if (chunk->getVisibleCellCount() == 0) {
+          continue;
+        }
+
+        //  The chunk's extent in cells, relative to the player.
+        int32_t minX = (chunkX * CHUNK_SIZE) - cx;
+        int32_t maxX = minX + CHUNK_SIZE - 1;
+        int32_t minY = (chunkY * CHUNK_SIZE) - cy;
+        int32_t maxY = minY + CHUNK_SIZE - 1;
+
+        //  Throw away chunks that are entirely behind the player before
+        //  bothering with the frustum.
+        clipWindowToFacing(facing, minX, maxX, minY, maxY);
+        if (minX > maxX || minY > maxY) {
+          continue;
+        }
+
+        if (isCellBoxVisible(frustum, minX, maxX, minY, maxY)) {
+          visibleChunks.push_back(chunk);
+          stats.chunksSubmitted++;
+          stats.cellsSubmitted += chunk->getVisibleCellCount();
+        }
+      }
+    }
+  }
+
+  void Map::drawActivatables(Graphics* g, const CellVisibility* visibility) {
+    for (uint32_t cell : visibility->getVisibleCells()) {
+      Activatable* act = getActivatable(cell % getWidth(), cell / getWidth());
+      if (act) {
+        act->draw(g);
+      }
+    }
+  }
+
+  void Map::drawCell(Graphics* g, const int32_t cx, const int32_t cy, const int32_t x, const int32_t y) {
+    g->drawFloorTile(x, y, getCell(cx + x, cy + y)->getFloor());
+    g->drawCeilingTile(x, y, getCell(cx + x, cy + y)->getCeiling());
+
+    /*
+     * Remember, the get*Wall() methods return the wall you'd see if you
+     * were facing the cell from that direction.  If we're to the east
+     * of the current cell, and facing it(We're facing west), we want
+     * the EAST wall of the cell.
+     */
+
+    uint8_t wallID;
+    if (isSolid(cx + x, cy + y - 1)) {
+      wallID = getCell(cx + x, cy + y - 1)->getSouthWall();
+      g->drawWallTile(x, y, Facing::NORTH, wallID);
+    }
+
+    if (isSolid(cx + x + 1, cy + y)) {
+      wallID = getCell(cx + x + 1, cy + y)->getWestWall();
+      g->drawWallTile(x, y, Facing::EAST, wallID);
+    }
+
+    if (isSolid(cx + x, cy + y + 1)) {
+      wallID = getCell(cx + x, cy + y + 1)->getNorthWall();
+      g->drawWallTile(x, y, Facing::SOUTH, wallID);
+    }
+
+    if (isSolid(cx + x - 1, cy + y)) {
+      wallID = getCell(cx + x - 1, cy + y)->getEastWall();
+      g->drawWallTile(x, y, Facing::WEST, wallID);
+    }
+
+    Activatable* act = getActivatable(cx + x, cy + y);
+    if (act) {
+      act->draw(g);
+    }
+  }
+
+  void Map::cullCells(Graphics* g, const ViewFrustum& frustum, const CellVisibility* visibility, const int32_t cx, const int32_t cy, const Facing facing) {
+    FrameStatistics& stats = g->getFrameStatistics();
+    visibleCells.clear();
+
+    //  The window of cells that the unculled loop would visit, trimmed to the
+    //  map itself.
+    int32_t minX = std::max(-MAX_DISTANCE, -cx);
+    int32_t maxX = std::min(MAX_DISTANCE - 1, getWidth() - 1 - cx);
+    int32_t minY = std::max(-MAX_DISTANCE, -cy);
+    int32_t maxY = std::min(MAX_DISTANCE - 1, getHeight() - 1 - cy);
+    if (minX > maxX || minY > maxY) {
+      return;
+    }
+
+    stats.cellsTested += (maxX - minX + 1) * (maxY - minY + 1);
+
+    //  Rows (or columns) behind the player are dropped entirely.
+    clipWindowToFacing(facing, minX, maxX, minY, maxY);
+
+    //  Only cells in line of sight are looked at, and then only the ones
+    //  that fall inside both the window and the frustum are drawn.
+    for (uint32_t cell : visibility->getVisibleCells()) {
+      int32_t x = (cell % getWidth()) - cx;
+      int32_t y = (cell / getWidth()) - cy;
+
+      if (x < minX || x > maxX || y < minY || y > maxY) {
+        continue;
+      }
+
+      if (isCellBoxVisible(frustum, x, x, y, y)) {
+        stats.cellsSubmitted++;
+        visibleCells.push_back(cell);
+      }
+    }
+  }
+
+  void Map::drawTileInstances(Graphics* g, const int32_t cx, const int32_t cy) {
+    floorInstances.clear();
+    ceilingInstances.clear();
+    wallInstances.clear();
+
+    //  Walls follow the same rules as in drawCell().
+    for (uint32_t cell : visibleCells) {
+      int32_t mapX = cell % getWidth();
+      int32_t mapY = cell / getWidth();
+      int32_t x = mapX - cx;
+      int32_t y = mapY - cy;
+
+      floorInstances.push_back(TileInstance(x, y, 0.0f));
+      ceilingInstances.push_back(TileInstance(x, y, 0.0f));
+
+      if (isSolid(mapX, mapY - 1)) {
+        wallInstances.push_back(TileInstance(x, y, Graphics::getWallTileAngle(Facing::NORTH)));
+      }
+
+      if (isSolid(mapX + 1, mapY)) {
+        wallInstances.push_back(TileInstance(x, y, Graphics::getWallTileAngle(Facing::EAST)));
+      }
+
+      if (isSolid(mapX, mapY + 1)) {
+        wallInstances.push_back(TileInstance(x, y, Graphics::getWallTileAngle(Facing::SOUTH)));
+      }
+
+      if (isSolid(mapX - 1, mapY)) {
+        wallInstances.push_back(TileInstance(x, y, Graphics::getWallTileAngle(Facing::WEST)));
+      }
+    }
+
+    g->drawFloorTiles(floorInstances);
+    g->drawCeilingTiles(ceilingInstances);
+    g->drawWallTiles(wallInstances);
+
+    for (uint32_t cell : visibleCells) {
+      Activatable* act = getActivatable(cell % getWidth(), cell / getWidth());
+      if (act) {
+        act->draw(g);
+      }
+    }
+  }
+
+  void Map::drawTiles(Graphics* g, const int32_t cx, const int32_t cy) {
+    for (uint32_t cell : visibleCells) {
+      drawCell(g, cx, cy, (cell % getWidth()) - cx, (cell / getWidth()) - cy);
+    }
+  }
+
+  /**
+   * A cell's walls are baked from the solidity of its neighbours, so a change
+   * to a cell on the edge of a chunk also dirties the chunk next to it.  Any
+   * change can also open or close a line of sight, so the cached visibility
+   * sets are thrown away.  Whether the precomputed set still matches is left
+   * until visibility is next asked for, since loading and editing a floor
+   * change many cells at once.
+   */
+  void Map::onMapCellChanged(MapCell* which) {
+    int32_t index = which - cells;
+    int32_t x = index % getWidth();
+    int32_t y = index / getWidth();
+
+    markCellDirty(x, y);
+    markCellDirty(x, y - 1);
+    markCellDirty(x + 1, y);
+    markCellDirty(x, y + 1);
+    markCellDirty(x - 1, y);
+
+    layoutHashDirty = true;
+    pvsUnchecked = (pvs != nullptr);
+    clearVisibilityCache();
+  }
+
+  void clipWindowToFacing(const Facing facing, int32_t& minX, int32_t& maxX,
+                          int32_t& minY, int32_t& maxY) {
+    //  The player's own row stays, since the cells to either side of them
+    //  are still partly in view.
+    switch (facing) {
+    case Facing::NORTH:
+      maxY = std::min(maxY, 0);
+      break;
+    case Facing::EAST:
+      minX = std::max(minX, 0);
+      break;
+    case Facing::SOUTH:
+      minY = std::max(minY, 0);
+      break;
+    case Facing::WEST:
+      maxX = std::min(maxX, 0);
+      break;
+    }
+  }
+
+  /**
+   * Tests a rectangle of cells, given in cells relative to the player,
+   * against the frustum.  The box covers everything a cell's tiles can
+   * occupy: 16 units square, from the floor up to the ceiling.
+   */
+  bool isCellBoxVisible(const ViewFrustum& frustum, const int32_t minX,
+                        const int32_t maxX, const int32_t minY,
+                        const int32_t maxY) {
+    return frustum.containsBox(Vector3((minX * 16.0f) - 8.0f, 0.0f, (minY * 16.0f) - 8.0f),
+                               Vector3((maxX * 16.0f) + 8.0f, 16.0f, (maxY * 16.0f) + 8.0f));
   }
 }
@@ -18,10 +18,26 @@
 
 #include "Graphics.hpp"
 #include "Activatables.hpp"
+#include "FloorGeometry.hpp"
+#include "ViewFrustum.hpp"
+#include "CellVisibility.hpp"
+#include "PotentiallyVisibleSet.hpp"
+#include <list>
+#include <map>
 #include <string>
+#include <vector>
 #include <cstdint>
 
 namespace io {
+  class MapCell;
+
+  class MapCellListener {
+  public:
+    virtual ~MapCellListener() { }
+    virtual void onMapCellChanged(MapCell* which) = 0;
+  private:
+  };
+
   /**
    * A MapCell represents a single cell in a map.  The resource IDs represent
    * how the cell looks from the outside, not from the inside.  Thus, when the
@@ -91,40 +107,57 @@ namespace io {
       }
       
       this->activatable = activatable;
+      notifyListener();
+    }
+
+    /**
+     * Sets the object that is told whenever the cell is modified.  The cell
+     * does not take ownership of the listener.
+     */
+    void setMapCellListener(MapCellListener* listener) {
+      this->listener = listener;
     }
 
     void setCeiling(const uint8_t cellCeiling) {
       this->ceiling = cellCeiling;
+      notifyListener();
     }
 
     void setFloor(const uint8_t cellFloor) {
       this->floor = cellFloor;
+      notifyListener();
     }
 
     void setEastWall(const uint8_t eastWall) {
       this->eastWall = eastWall;
+      notifyListener();
     }
 
     void setNorthWall(const uint8_t northWall) {
       this->northWall = northWall;
+      notifyListener();
     }
 
     void setSouthWall(const uint8_t southWall) {
       this->southWall = southWall;
+      notifyListener();
     }
 
     void setWestWall(const uint8_t westWall) {
       this->westWall = westWall;
+      notifyListener();
     }
 
     void setSolid(bool solid) {
       this->solid = solid;
+      notifyListener();
     }
   private:
     MapCell(const MapCell&) = delete;
     MapCell& operator=(const MapCell&) = delete;
     
     Activatable* activatable = nullptr;
+    MapCellListener* listener = nullptr;
     uint8_t ceiling = 0;
     uint8_t floor = 0;
     uint8_t eastWall = 0;
@@ -132,15 +165,29 @@ namespace io {
     uint8_t southWall = 0;
     uint8_t westWall = 0;
     bool solid = true;
+
+    void notifyListener() {
+      if (listener) {
+        listener->onMapCellChanged(this);
+      }
+    }
   };
 
   /**
    * Represents a map.  Currently hard-coded to 35 * 30 cells in size.
    */
-  class Map {
+  class Map : public MapCellListener {
   public:
     const static int32_t MAX_MAP_WIDTH = 128;
     const static int32_t MAX_MAP_HEIGHT = 128;
+
+    //  The baked geometry is split into square chunks of this many cells.
+    const static int32_t CHUNK_SIZE = 16;
+
+    //  How many rays are cast to work out what the player can see, and how
+    //  many of the results are kept around.
+    const static uint32_t VISIBILITY_RAY_COUNT = 1024;
+    const static uint32_t VISIBILITY_CACHE_SIZE = 16;
     
     Map(const int32_t width, const int32_t height) {
       if (width <= 0|| height <= 0 || width > MAX_MAP_WIDTH ||
@@ -149,12 +196,29 @@ namespace io {
       }
       
       cells = new MapCell[width * height];
+      for (int32_t i = 0; i < width * height; i++) {
+        cells[i].setMapCellListener(this);
+      }
       
       this->width = width;
       this->height = height;
+
+      chunksWide = (width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+      chunksHigh = (height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+      for (int32_t i = 0; i < chunksWide * chunksHigh; i++) {
+        chunks.push_back(new FloorGeometry());
+      }
     }
 
-    ~Map() {
+    virtual ~Map() {
+      clearVisibilityCache();
+      setPotentiallyVisibleSet(nullptr);
+
+      for (FloorGeometry* chunk : chunks) {
+        delete chunk;
+      }
+      chunks.clear();
+
       delete [] cells;
       cells = nullptr;
     }
@@ -162,7 +226,9 @@ namespace io {
     static Map* mapFromXML(const std::string& filename);
     static Map* mapFromImage(const std::string& filename);
     
-    void draw(Graphics* g, const int32_t x, const int32_t y);
+    void bakeGeometry(Graphics* g);
+    void computeVisibility(CellVisibility* out, const int32_t x, const int32_t y, const Facing facing);
+    void draw(Graphics* g, const int32_t x, const int32_t y, const Facing facing);
     
     Activatable* getActivatable(const int32_t x, const int32_t y) {
       if (getCell(x, y)) {
@@ -175,11 +241,32 @@ namespace io {
     int32_t getWidth() const {
       return width;
     }
+
+    /**
+     * Returns the cells that can be seen from (x, y) looking in the given
+     * direction.  The result is cached, and stays valid until the map is
+     * changed or the next call.
+     */
+    const CellVisibility* getVisibility(const int32_t x, const int32_t y, const Facing facing);
     
     int32_t getHeight() const {
       return height;
     }
 
+    /**
+     * A hash of which cells are solid, which precomputed visibility sets
+     * are tied to.  Changing cells only marks it out of date; it's worked
+     * out again the next time it's asked for.
+     */
+    uint32_t getLayoutHash();
+
+    const PotentiallyVisibleSet* getPotentiallyVisibleSet() const {
+      return pvs;
+    }
+
+    //  Where the visibility set of a floor file is saved, see tools/.
+    static std::string getPotentiallyVisibleSetFilename(const std::string& floorFilename);
+
     bool isSolid(const int32_t x, const int32_t y) {
       if (getCell(x, y)) {
         return getCell(x, y)->isSolid();
@@ -195,14 +282,59 @@ namespace io {
       
       return false;
     }
+
+    virtual void onMapCellChanged(MapCell* which);
+
+    /**
+     * Gives the map a precomputed visibility set to use instead of casting
+     * rays.  The map takes ownership of it.
+     */
+    void setPotentiallyVisibleSet(PotentiallyVisibleSet* pvs) {
+      if (this->pvs && this->pvs != pvs) {
+        delete this->pvs;
+      }
+
+      this->pvs = pvs;
+      pvsUnchecked = false;
+      clearVisibilityCache();
+    }
   private:
     Map(const Map&) = delete;
     Map& operator=(const Map&) = delete;
     
     MapCell* cells;
+    std::vector<FloorGeometry*> chunks;
+    std::vector<FloorGeometry*> visibleChunks;
+    std::vector<uint32_t> visibleCells;
+    std::vector<TileInstance> floorInstances;
+    std::vector<TileInstance> ceilingInstances;
+    std::vector<TileInstance> wallInstances;
+    int32_t chunksWide;
+    int32_t chunksHigh;
     int32_t width;
     int32_t height;
+
+    std::map<uint32_t, CellVisibility*> visibilityCache;
+    std::list<uint32_t> visibilityCacheOrder;
+    PotentiallyVisibleSet* pvs = nullptr;
+    uint32_t layoutHash = 0;
+    bool layoutHashDirty = true;
+
+    //  Set when cells change, until the precomputed set is checked against
+    //  the new layout.
+    bool pvsUnchecked = false;
     
+    void bakeChunk(Graphics* g, const int32_t chunkX, const int32_t chunkY);
+    void castVisibilityRay(CellVisibility* out, const int32_t x, const int32_t y, const float dirX, const float dirY);
+    void clearVisibilityCache();
+    void cullCells(Graphics* g, const ViewFrustum& frustum, const CellVisibility* visibility, const int32_t cx, const int32_t cy, const Facing facing);
+    void cullChunks(Graphics* g, const ViewFrustum& frustum, const CellVisibility* visibility, const int32_t cx, const int32_t cy, const Facing facing);
+    void drawActivatables(Graphics* g, const CellVisibility* visibility);
+    void drawCell(Graphics* g, const int32_t cx, const int32_t cy, const int32_t x, const int32_t y);
+    void drawTileInstances(Graphics* g, const int32_t cx, const int32_t cy);
+    void drawTiles(Graphics* g, const int32_t cx, const int32_t cy);
+    void loadPotentiallyVisibleSet(const std::string& filename);
+
     MapCell* getCell(const int32_t x, const int32_t y) {
       if (x < 0 || y < 0 || x >= getWidth() || y >= getHeight()) {
         return nullptr;
@@ -210,6 +342,25 @@ namespace io {
       
       return (cells + (y * getWidth()) + x);
     }
+
+    //  The index of a cell within its chunk.
+    uint32_t getChunkCellIndex(const int32_t x, const int32_t y) const {
+      return ((y % CHUNK_SIZE) * CHUNK_SIZE) + (x % CHUNK_SIZE);
+    }
+
+    FloorGeometry* getChunk(const int32_t chunkX, const int32_t chunkY) {
+      if (chunkX < 0 || chunkY < 0 || chunkX >= chunksWide || chunkY >= chunksHigh) {
+        return nullptr;
+      }
+
+      return chunks.at((chunkY * chunksWide) + chunkX);
+    }
+
+    void markCellDirty(const int32_t x, const int32_t y) {
+      if (x >= 0 && y >= 0 && x < getWidth() && y < getHeight()) {
+        getChunk(x / CHUNK_SIZE, y / CHUNK_SIZE)->markDirty();
+      }
+    }
   };
 }
 #endif // mapHPP
@@ -16,54 +16,47 @@
 #include "Matrix.hpp"
 #include <exception>
 
+//  Rows are loaded unaligned.  The matrix is aligned, but not every
+//  allocator honours it, and on aligned data the two cost the same.
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define MATRIX_SSE
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define MATRIX_NEON
+#include <arm_neon.h>
+#endif
+
 namespace io {
-  Matrix::Matrix() {
-    this->set(0, 0, 0.0f);
-    this->set(0, 1, 0.0f);
-    this->set(0, 2, 0.0f);
-    this->set(0, 3, 0.0f);
-    this->set(1, 0, 0.0f);
-    this->set(1, 1, 0.0f);
-    this->set(1, 2, 0.0f);
-    this->set(1, 3, 0.0f);
-    this->set(2, 0, 0.0f);
-    this->set(2, 1, 0.0f);
-    this->set(2, 2, 0.0f);
-    this->set(2, 3, 0.0f);
-    this->set(3, 0, 0.0f);
-    this->set(3, 1, 0.0f);
-    this->set(3, 2, 0.0f);
-    this->set(3, 3, 0.0f);
-  }
-
-  Matrix::Matrix(const float m11, const float m12, const float m13, const float m14,
-                 const float m21, const float m22, const float m23, const float m24,
-                 const float m31, const float m32, const float m33, const float m34,
-                 const float m41, const float m42, const float m43, const float m44) {
-    this->set(0, 0, m11);
-    this->set(0, 1, m12);
-    this->set(0, 2, m13);
-    this->set(0, 3, m14);
-    this->set(1, 0, m21);
-    this->set(1, 1, m22);
-    this->set(1, 2, m23);
-    this->set(1, 3, m24);
-    this->set(2, 0, m31);
-    this->set(2, 1, m32);
-    this->set(2, 2, m33);
-    this->set(2, 3, m34);
-    this->set(3, 0, m41);
-    this->set(3, 1, m42);
-    this->set(3, 2, m43);
-    this->set(3, 3, m44);
+#ifdef MATRIX_SSE
+  //  _MM_SHUFFLE() takes its lanes highest first, this lowest first.
+  #define MATRIX_SHUFFLE(a, b, x, y, z, w) _mm_shuffle_ps((a), (b), _MM_SHUFFLE((w), (z), (y), (x)))
+  #define MATRIX_SWIZZLE(a, x, y, z, w) MATRIX_SHUFFLE((a), (a), (x), (y), (z), (w))
+
+  //  The four lanes are 2x2 matrices, a row at a time.  Returns a * b.
+  static inline __m128 multiply2x2(const __m128 a, const __m128 b) {
+    return _mm_add_ps(_mm_mul_ps(a, MATRIX_SWIZZLE(b, 0, 3, 0, 3)),
+                      _mm_mul_ps(MATRIX_SWIZZLE(a, 1, 0, 3, 2), MATRIX_SWIZZLE(b, 2, 1, 2, 1)));
   }
 
+  //  adjugate(a) * b.
+  static inline __m128 adjugateMultiply2x2(const __m128 a, const __m128 b) {
+    return _mm_sub_ps(_mm_mul_ps(MATRIX_SWIZZLE(a, 3, 3, 0, 0), b),
+                      _mm_mul_ps(MATRIX_SWIZZLE(a, 1, 1, 2, 2), MATRIX_SWIZZLE(b, 2, 3, 0, 1)));
+  }
+
+  //  a * adjugate(b).
+  static inline __m128 multiplyAdjugate2x2(const __m128 a, const __m128 b) {
+    return _mm_sub_ps(_mm_mul_ps(a, MATRIX_SWIZZLE(b, 3, 0, 3, 0)),
+                      _mm_mul_ps(MATRIX_SWIZZLE(a, 1, 0, 3, 2), MATRIX_SWIZZLE(b, 2, 1, 2, 1)));
+  }
+#endif
+
   Matrix Matrix::operator+(const Matrix& rhs) const {
     Matrix out;
 
     for (uint32_t row = 0; row < 4; row++) {
       for (uint32_t column = 0; column < 4; column++) {
-        out.set(row, column, this->get(row, column) + rhs.get(row, column));
+        out.matrix[row][column] = this->matrix[row][column] + rhs.matrix[row][column];
       }
     }
 
@@ -75,27 +68,58 @@ namespace io {
 
     for (uint32_t row = 0; row < 4; row++) {
       for (uint32_t column = 0; column < 4; column++) {
-        out.set(row, column, this->get(row, column) - rhs.get(row, column));
+        out.matrix[row][column] = this->matrix[row][column] - rhs.matrix[row][column];
       }
     }
 
     return out;
   }
 
+  /**
+   * Each row of the result is the rows of rhs, weighted by the matching row
+   * of this matrix, which is four multiplies and three adds of whole rows.
+   */
   Matrix Matrix::operator*(const Matrix& rhs) const {
     Matrix out;
 
-    for (uint32_t row = 0; row < 4; row++) {
-      for (uint32_t column = 0; column < 4; column++) {
-        float sum = 0.0;
+#if defined(MATRIX_SSE)
+    __m128 rows[4];
+    for (uint32_t i = 0; i < 4; i++) {
+      rows[i] = _mm_loadu_ps(rhs.matrix[i]);
+    }
 
-        for (uint32_t i = 0; i < 4; i++) {
-          sum += this->get(row, i) * rhs.get(i, column);
-        }
+    for (uint32_t row = 0; row < 4; row++) {
+      const float* lhs = this->matrix[row];
+      __m128 sum = _mm_mul_ps(_mm_set1_ps(lhs[0]), rows[0]);
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(lhs[1]), rows[1]));
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(lhs[2]), rows[2]));
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(lhs[3]), rows[3]));
+      _mm_storeu_ps(out.matrix[row], sum);
+    }
+#elif defined(MATRIX_NEON)
+    float32x4_t rows[4];
+    for (uint32_t i = 0; i < 4; i++) {
+      rows[i] = vld1q_f32(rhs.matrix[i]);
+    }
 
-        out.set(row, column, sum);
+    for (uint32_t row = 0; row < 4; row++) {
+      const float* lhs = this->matrix[row];
+      float32x4_t sum = vmulq_n_f32(rows[0], lhs[0]);
+      sum = vmlaq_n_f32(sum, rows[1], lhs[1]);
+      sum = vmlaq_n_f32(sum, rows[2], lhs[2]);
+      sum = vmlaq_n_f32(sum, rows[3], lhs[3]);
+      vst1q_f32(out.matrix[row], sum);
+    }
+#else
+    for (uint32_t row = 0; row < 4; row++) {
+      for (uint32_t column = 0; column < 4; column++) {
+        out.matrix[row][column] = (this->matrix[row][0] * rhs.matrix[0][column]) +
+                                  (this->matrix[row][1] * rhs.matrix[1][column]) +
+                                  (this->matrix[row][2] * rhs.matrix[2][column]) +
+                                  (this->matrix[row][3] * rhs.matrix[3][column]);
       }
     }
+#endif
 
     return out;
   }
@@ -105,7 +129,7 @@ namespace io {
 
     for (uint32_t row = 0; row < 4; row++) {
       for (uint32_t column = 0; column < 4; column++) {
-        out.set(row, column, this->get(row, column) * scaler);
+        out.matrix[row][column] = this->matrix[row][column] * scaler;
       }
     }
 
@@ -118,7 +142,7 @@ namespace io {
     try {
       for (uint32_t row = 0; row < 4; row++) {
         for (uint32_t column = 0; column < 4; column++) {
-          out.set(row, column, this->get(row, column) / scaler);
+          out.matrix[row][column] = this->matrix[row][column] / scaler;
         }
       }
     } catch(std::exception&) {
@@ -128,30 +152,208 @@ namespace io {
     return out;
   }
 
-  float Matrix::get(const uint32_t row, const uint32_t column) const {
-    if (row >= 4 || column >= 4) {
-      return 0.0f;
+  /**
+   * The upper left 3x3 is inverted by its adjugate, and the translation is
+   * taken back out through it.
+   */
+  Matrix Matrix::affineInverse() const {
+    const float (*m)[4] = this->matrix;
+
+    float c00 = (m[1][1] * m[2][2]) - (m[1][2] * m[2][1]);
+    float c01 = (m[1][2] * m[2][0]) - (m[1][0] * m[2][2]);
+    float c02 = (m[1][0] * m[2][1]) - (m[1][1] * m[2][0]);
+    float determinant = (m[0][0] * c00) + (m[0][1] * c01) + (m[0][2] * c02);
+    if (determinant == 0.0f) {
+      return Matrix::zero();
+    }
+
+    float r = 1.0f / determinant;
+    Matrix out(c00 * r, ((m[0][2] * m[2][1]) - (m[0][1] * m[2][2])) * r, ((m[0][1] * m[1][2]) - (m[0][2] * m[1][1])) * r, 0.0f,
+               c01 * r, ((m[0][0] * m[2][2]) - (m[0][2] * m[2][0])) * r, ((m[0][2] * m[1][0]) - (m[0][0] * m[1][2])) * r, 0.0f,
+               c02 * r, ((m[0][1] * m[2][0]) - (m[0][0] * m[2][1])) * r, ((m[0][0] * m[1][1]) - (m[0][1] * m[1][0])) * r, 0.0f,
+               0.0f, 0.0f, 0.0f, 1.0f);
+
+    for (uint32_t row = 0; row < 3; row++) {
+      out.matrix[row][3] = -((out.matrix[row][0] * m[0][3]) + (out.matrix[row][1] * m[1][3]) + (out.matrix[row][2] * m[2][3]));
+    }
+
+    return out;
+  }
+
+  /**
+   * With SSE, the matrix is split into four 2x2 blocks, which are each
+   * one vector, and inverted blockwise.  Otherwise the adjugate is worked
+   * out by cofactors.
+   */
+  Matrix Matrix::inverse() const {
+    Matrix out;
+
+#if defined(MATRIX_SSE)
+    __m128 row0 = _mm_loadu_ps(this->matrix[0]);
+    __m128 row1 = _mm_loadu_ps(this->matrix[1]);
+    __m128 row2 = _mm_loadu_ps(this->matrix[2]);
+    __m128 row3 = _mm_loadu_ps(this->matrix[3]);
+
+    //  | A B |
+    //  | C D |
+    __m128 a = _mm_movelh_ps(row0, row1);
+    __m128 b = _mm_movehl_ps(row1, row0);
+    __m128 c = _mm_movelh_ps(row2, row3);
+    __m128 d = _mm_movehl_ps(row3, row2);
+
+    //  (|A|, |B|, |C|, |D|)
+    __m128 determinants = _mm_sub_ps(_mm_mul_ps(MATRIX_SHUFFLE(row0, row2, 0, 2, 0, 2), MATRIX_SHUFFLE(row1, row3, 1, 3, 1, 3)),
+                                     _mm_mul_ps(MATRIX_SHUFFLE(row0, row2, 1, 3, 1, 3), MATRIX_SHUFFLE(row1, row3, 0, 2, 0, 2)));
+    __m128 determinantA = MATRIX_SWIZZLE(determinants, 0, 0, 0, 0);
+    __m128 determinantB = MATRIX_SWIZZLE(determinants, 1, 1, 1, 1);
+    __m128 determinantC = MATRIX_SWIZZLE(determinants, 2, 2, 2, 2);
+    __m128 determinantD = MATRIX_SWIZZLE(determinants, 3, 3, 3, 3);
+
+    __m128 dc = adjugateMultiply2x2(d, c);
+    __m128 ab = adjugateMultiply2x2(a, b);
+
+    //  The adjugates of the blocks of the inverse, before the divide.
+    __m128 x = _mm_sub_ps(_mm_mul_ps(determinantD, a), multiply2x2(b, dc));
+    __m128 w = _mm_sub_ps(_mm_mul_ps(determinantA, d), multiply2x2(c, ab));
+    __m128 y = _mm_sub_ps(_mm_mul_ps(determinantB, c), multiplyAdjugate2x2(d, ab));
+    __m128 z = _mm_sub_ps(_mm_mul_ps(determinantC, b), multiplyAdjugate2x2(a, dc));
+
+    //  |M| = |A||D| + |B||C| - tr((A#B)(D#C))
+    __m128 trace = _mm_mul_ps(ab, MATRIX_SWIZZLE(dc, 0, 2, 1, 3));
+    trace = _mm_add_ps(trace, MATRIX_SWIZZLE(trace, 1, 0, 3, 2));
+    trace = _mm_add_ps(trace, MATRIX_SWIZZLE(trace, 2, 3, 0, 1));
+    __m128 determinant = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(determinantA, determinantD), _mm_mul_ps(determinantB, determinantC)), trace);
+    if (_mm_cvtss_f32(determinant) == 0.0f) {
+      return Matrix::zero();
+    }
+
+    __m128 reciprocal = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), determinant);
+    x = _mm_mul_ps(x, reciprocal);
+    y = _mm_mul_ps(y, reciprocal);
+    z = _mm_mul_ps(z, reciprocal);
+    w = _mm_mul_ps(w, reciprocal);
+
+    //  Taking the adjugates and putting the blocks back in rows at once.
+    _mm_storeu_ps(out.matrix[0], MATRIX_SHUFFLE(x, y, 3, 1, 3, 1));
+    _mm_storeu_ps(out.matrix[1], MATRIX_SHUFFLE(x, y, 2, 0, 2, 0));
+    _mm_storeu_ps(out.matrix[2], MATRIX_SHUFFLE(z, w, 3, 1, 3, 1));
+    _mm_storeu_ps(out.matrix[3], MATRIX_SHUFFLE(z, w, 2, 0, 2, 0));
+#else
+    const float* m = &this->matrix[0][0];
+    float* o = &out.matrix[0][0];
+
+    o[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+    o[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+    o[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+    o[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+    o[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+    o[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+    o[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+    o[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+    o[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+    o[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+    o[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+    o[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+    o[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+    o[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+    o[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+    o[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+    float determinant = (m[0] * o[0]) + (m[1] * o[4]) + (m[2] * o[8]) + (m[3] * o[12]);
+    if (determinant == 0.0f) {
+      return Matrix::zero();
+    }
+
+    float r = 1.0f / determinant;
+    for (uint32_t i = 0; i < 16; i++) {
+      o[i] *= r;
+    }
+#endif
+
+    return out;
+  }
+
+  Matrix Matrix::rotatedX(const float cosine, const float sine) const {
+    Matrix out(*this);
+
+    for (uint32_t row = 0; row < 4; row++) {
+      float y = this->matrix[row][1];
+      float z = this->matrix[row][2];
+      out.matrix[row][1] = (y * cosine) + (z * sine);
+      out.matrix[row][2] = (z * cosine) - (y * sine);
+    }
+
+    return out;
+  }
+
+  Matrix Matrix::rotatedY(const float cosine, const float sine) const {
+    Matrix out(*this);
+
+    for (uint32_t row = 0; row < 4; row++) {
+      float x = this->matrix[row][0];
+      float z = this->matrix[row][2];
+      out.matrix[row][0] = (x * cosine) - (z * sine);
+      out.matrix[row][2] = (x * sine) + (z * cosine);
+    }
+
+    return out;
+  }
+
+  Matrix Matrix::rotatedZ(const float cosine, const float sine) const {
+    Matrix out(*this);
+
+    for (uint32_t row = 0; row < 4; row++) {
+      float x = this->matrix[row][0];
+      float y = this->matrix[row][1];
+      out.matrix[row][0] = (x * cosine) + (y * sine);
+      out.matrix[row][1] = (y * cosine) - (x * sine);
+    }
+
+    return out;
+  }
+
+  Matrix Matrix::scaled(const float x, const float y, const float z) const {
+    Matrix out(*this);
+
+    for (uint32_t row = 0; row < 4; row++) {
+      out.matrix[row][0] *= x;
+      out.matrix[row][1] *= y;
+      out.matrix[row][2] *= z;
     }
 
-    return this->matrix[row][column];
+    return out;
   }
 
-  void Matrix::set(const uint32_t row, const uint32_t column, const float in) {
-    if (row >= 4 || column >= 4) {
-      return;
+  Matrix Matrix::translated(const float x, const float y, const float z) const {
+    Matrix out(*this);
+
+    for (uint32_t row = 0; row < 4; row++) {
+      out.matrix[row][3] += (this->matrix[row][0] * x) + (this->matrix[row][1] * y) + (this->matrix[row][2] * z);
     }
 
-    this->matrix[row][column] = in;
+    return out;
   }
 
   Matrix Matrix::transpose() const {
     Matrix out;
 
+#if defined(MATRIX_SSE)
+    __m128 row0 = _mm_loadu_ps(this->matrix[0]);
+    __m128 row1 = _mm_loadu_ps(this->matrix[1]);
+    __m128 row2 = _mm_loadu_ps(this->matrix[2]);
+    __m128 row3 = _mm_loadu_ps(this->matrix[3]);
+    _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+    _mm_storeu_ps(out.matrix[0], row0);
+    _mm_storeu_ps(out.matrix[1], row1);
+    _mm_storeu_ps(out.matrix[2], row2);
+    _mm_storeu_ps(out.matrix[3], row3);
+#else
     for (uint32_t y = 0; y < 4; y++) {
       for (uint32_t x = 0; x < 4; x++) {
-        out.set(y, x, this->get(y, x));
+        out.matrix[x][y] = this->matrix[y][x];
       }
     }
+#endif
 
     return out;
   }
@@ -23,31 +23,28 @@
 
 namespace io {
   /**
-   * Represents a 4x4 matrix in column-major form, for OpenGL.
+   * Represents a 4x4 matrix in column-major form, for OpenGL.  Each row is
+   * 16 bytes, and the matrix is aligned to them, so that a row can be
+   * worked on as one SSE or NEON vector, see Matrix.cpp.
    */
-  class Matrix {
+  class alignas(16) Matrix {
   public:
-    Matrix();
-
-    Matrix(const Matrix& other) {
-      ::memcpy(this->matrix, other.matrix, sizeof(float) * 16);
+    constexpr Matrix() : matrix{} {
     }
 
-    Matrix(const float m11, const float m12, const float m13, const float m14,
-           const float m21, const float m22, const float m23, const float m24,
-           const float m31, const float m32, const float m33, const float m34,
-           const float m41, const float m42, const float m43, const float m44);
-
-    ~Matrix() {
-
+    constexpr Matrix(const float m11, const float m12, const float m13, const float m14,
+                     const float m21, const float m22, const float m23, const float m24,
+                     const float m31, const float m32, const float m33, const float m34,
+                     const float m41, const float m42, const float m43, const float m44)
+      : matrix{{m11, m12, m13, m14}, {m21, m22, m23, m24}, {m31, m32, m33, m34}, {m41, m42, m43, m44}} {
     }
 
-    Matrix& operator=(const Matrix& rhs) {
-      if (&rhs != this) {
-        ::memcpy(this->matrix, rhs.matrix, sizeof(float) * 16);
-      }
+    bool operator==(const Matrix& rhs) const {
+      return (::memcmp(this->matrix, rhs.matrix, sizeof(float) * 16) == 0);
+    }
 
-      return *this;
+    bool operator!=(const Matrix& rhs) const {
+      return !(*this == rhs);
     }
 
     Matrix operator+(const Matrix& rhs) const;
@@ -60,10 +57,16 @@ namespace io {
 
     Matrix operator/(const float scaler) const;
 
-    float get(const uint32_t row, const uint32_t column) const;
+    float get(const uint32_t row, const uint32_t column) const {
+      if (row >= 4 || column >= 4) {
+        return 0.0f;
+      }
+
+      return this->matrix[row][column];
+    }
 
     //  Returns an identity matrix.
-    static Matrix identity() {
+    constexpr static Matrix identity() {
       return Matrix(1.0f, 0.0f, 0.0f, 0.0f,
                     0.0f, 1.0f, 0.0f, 0.0f,
                     0.0f, 0.0f, 1.0f, 0.0f,
@@ -74,6 +77,20 @@ namespace io {
       return (float*)this->matrix;
     }
 
+    /**
+     * Returns the inverse, or a zero matrix if there isn't one.
+     * affineInverse() does about half the work, but only for matrices whose
+     * bottom row is (0, 0, 0, 1), such as those made from translations,
+     * rotations and scales.  It's quicker without SSE, and keeps that row
+     * exact.
+     */
+    Matrix inverse() const;
+    Matrix affineInverse() const;
+
+    bool isAffine() const {
+      return (matrix[3][0] == 0.0f && matrix[3][1] == 0.0f && matrix[3][2] == 0.0f && matrix[3][3] == 1.0f);
+    }
+
     //  Returns a 2D rotation matrix along the Z axis.
     static Matrix rotation(const float angle) {
       float x = ::cos(angle);
@@ -108,6 +125,25 @@ namespace io {
                     1);
     }
 
+    /**
+     * The same as rotation() about the y axis, from the cosine and sine of
+     * the angle.  Right angles have exact ones, so turns by them can be
+     * made by the compiler.
+     */
+    constexpr static Matrix rotationY(const float cosine, const float sine) {
+      return Matrix(cosine, 0.0f,   sine, 0.0f,
+                      0.0f, 1.0f,   0.0f, 0.0f,
+                     -sine, 0.0f, cosine, 0.0f,
+                      0.0f, 0.0f,   0.0f, 1.0f);
+    }
+
+    /**
+     * This matrix times a rotation about one axis, from the cosine and sine
+     * of the angle.  Only the two columns the rotation mixes are worked out.
+     */
+    Matrix rotatedX(const float cosine, const float sine) const;
+    Matrix rotatedY(const float cosine, const float sine) const;
+    Matrix rotatedZ(const float cosine, const float sine) const;
 
     //  Returns a 2D scaling matrix.
     static Matrix scale(const float x, const float y) {
@@ -124,6 +160,9 @@ namespace io {
                        0.0f, 0.0f, 0.0f, 1.0f);
     }
 
+    //  This matrix times scale(x, y, z), without the multiply.
+    Matrix scaled(const float x, const float y, const float z) const;
+
     static Matrix ortho2D(const float left, const float right, const float bottom, const float top) {
       float ffar = 1.0;
       float fnear = -1.0;
@@ -144,30 +183,36 @@ namespace io {
                     0,                           0, -1, 0);
     }
 
-    void set(const uint32_t row, const uint32_t column, const float in);
+    void set(const uint32_t row, const uint32_t column, const float in) {
+      if (row >= 4 || column >= 4) {
+        return;
+      }
+
+      this->matrix[row][column] = in;
+    }
 
     //  Returns a 2D translation matrix.
-    static Matrix translation(const float x, const float y) {
+    constexpr static Matrix translation(const float x, const float y) {
       return Matrix(1.0, 0.0, 0.0,   x,
                     0.0, 1.0, 0.0,   y,
                     0.0, 0.0, 1.0, 0.0,
                     0.0, 0.0, 0.0, 1.0);
     }
 
-    static Matrix translation(const float x, const float y, const float z) {
+    constexpr static Matrix translation(const float x, const float y, const float z) {
       return Matrix(1.0f, 0.0f, 0.0f,    x,
                     0.0f, 1.0f, 0.0f,    y,
                     0.0f, 0.0f, 1.0f,    z,
                     0.0f, 0.0f, 0.0f, 1.0f);
     }
 
+    //  This matrix times translation(x, y, z), without the multiply.
+    Matrix translated(const float x, const float y, const float z) const;
+
     Matrix transpose() const;
 
-    Matrix zero() const {
-      return Matrix(0.0f, 0.0f, 0.0f, 0.0f,
-                    0.0f, 0.0f, 0.0f, 0.0f,
-                    0.0f, 0.0f, 0.0f, 0.0f,
-                    0.0f, 0.0f, 0.0f, 0.0f);
+    constexpr static Matrix zero() {
+      return Matrix();
     }
   private:
     float matrix[4][4];
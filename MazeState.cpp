@@ -82,7 +82,7 @@ namespace io {
     g->setMatrixMode(MatrixMode::MODEL);
     g->loadIdentity();
 
-    currentMap->draw(g, player->getX(), player->getY());
+    currentMap->draw(g, player->getX(), player->getY(), player->getFacing());
   }
 
   void MazeState::handleInputEvent(const InputEvent& event) {
@@ -81,7 +81,9 @@ namespace io {
       for (uint32_t i = windowStart; i < menuItems.size() && i < windowEnd; i++) {
         MenuItem* item = menuItems.at(i);
 
-        BoundingBox textBox = f->getTextBoundingBox(item->getText());
+        TextLayout& layout = item->getLayout();
+        layout.setFont(f);
+        BoundingBox textBox = layout.getBoundingBox();
         Colour c;
         if (item->isEnabled()) {
           if (i == menuSelection) {
@@ -100,7 +102,7 @@ namespace io {
           }
         }
 
-        f->drawText(item->getText(), c);
+        layout.draw(g, c);
         g->translate(0, textBox.h, 0);
       }
     }
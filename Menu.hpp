@@ -50,6 +50,7 @@ namespace io {
       if (!hasID(id)) {
         ret = new MenuItem(id, text, enabled);
         menuItems.push_back(ret);
+        invalidate();
       }
       return ret;
     }
@@ -59,6 +60,7 @@ namespace io {
         delete m;
       }
       menuItems.clear();
+      invalidate();
     }
 
     Font* getFont() const {
@@ -79,6 +81,28 @@ namespace io {
       return nullptr;
     }
 
+    //  The items can change without the menu knowing, so they're asked too.
+    virtual bool isDirty() const {
+      if (Component::isDirty()) {
+        return true;
+      }
+
+      for (MenuItem* m : menuItems) {
+        if (m->isDirty()) {
+          return true;
+        }
+      }
+
+      return false;
+    }
+
+    virtual void markClean() {
+      Component::markClean();
+      for (MenuItem* m : menuItems) {
+        m->markClean();
+      }
+    }
+
     MenuItem* getSelectedMenuItem() const {
       if (menuItems.size() == 0) {
         return nullptr;
@@ -124,11 +148,13 @@ namespace io {
 
       if (iter != menuItems.end()) {
         menuItems.erase(iter);
+        invalidate();
       }
     }
 
     void setFont(Font* font) {
       this->font = font;
+      invalidate();
     }
 
     void setMaxVisibleItems(const uint32_t maxVisibleItems) {
@@ -191,6 +217,8 @@ namespace io {
     virtual void render(Graphics* g);
 
     void validateWindow() {
+      invalidate();
+
       if (getMenuSelection() < windowStart) {
         windowStart = getMenuSelection();
         windowEnd = windowStart + getMaxVisibleItems();
@@ -18,14 +18,21 @@
 
 #include <cstdint>
 #include <string>
+#include "TextLayout.hpp"
 
 namespace io {
   class MenuItem {
   public:
     MenuItem(const uint32_t id, const std::string text, bool enabled) {
       this->id = id;
-      this->text = text;
       this->enabled = enabled;
+      this->dirty = true;
+      layout.setText(text);
+    }
+
+    //  Set when the item changes, until its menu is redrawn.
+    bool isDirty() const {
+      return dirty;
     }
 
     bool isEnabled() {
@@ -40,21 +47,37 @@ namespace io {
       return id;
     }
 
+    //  Laid out with the menu's font when the menu is drawn.
+    TextLayout& getLayout() {
+      return layout;
+    }
+
     std::string getText() const {
-      return text;
+      return layout.getText();
+    }
+
+    void markClean() {
+      dirty = false;
     }
 
     void setEnabled(const bool enabled) {
-      this->enabled = enabled;
+      if (enabled != this->enabled) {
+        this->enabled = enabled;
+        dirty = true;
+      }
     }
 
-    void setText(const uint32_t text) {
-      this->text = text;
+    void setText(const std::string& text) {
+      if (text != layout.getText()) {
+        layout.setText(text);
+        dirty = true;
+      }
     }
   private:
+    bool dirty;
     bool enabled;
     uint32_t id;
-    std::string text;
+    TextLayout layout;
   };
 }
 
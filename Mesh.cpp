@@ -49,32 +49,32 @@ namespace io {
       }
 
       if (vertices.size() >= minVertices && isValid()) {
+        //  Straight into the stream if there's room, with no buffer of its
+        //  own to reallocate.
+        streamed = (stream && stream->write(vertices.data(), vertices.size() * sizeof(Vertex), streamOffset));
+        if (streamed) {
+          open = false;
+          return;
+        }
+
         if (bufferID == 0) {
           glGenBuffers(1, &bufferID);
         }
 
         if (bufferID != 0) {
-          GLuint oldVBuffer = 0;
-          glGetIntegerv(GL_ARRAY_BUFFER_BINDING, (GLint*)&oldVBuffer);
-
-          glBindBuffer(GL_ARRAY_BUFFER, bufferID);
+          //  Everything binds its buffer through GLState before use, so
+          //  there's no need to put the old one back afterwards.
+          GLState::getInstance()->bindArrayBuffer(bufferID);
 
           if (glGetError() != GL_NO_ERROR) {
           }
 
-          Vertex* tmpBuffer = new (std::nothrow) Vertex[vertices.size()];
-          for (std::size_t i = 0; i < vertices.size(); i++) {
-            tmpBuffer[i] = vertices[i];
-          }
-
-          glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), tmpBuffer, GL_STATIC_DRAW);
-
-          delete [] tmpBuffer;
+          glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), stream ? GL_STREAM_DRAW : GL_STATIC_DRAW);
+          GLState::getInstance()->recordBufferUpload(vertices.size() * sizeof(Vertex));
 
           open = false;
           valid = true;
 
-          glBindBuffer(GL_ARRAY_BUFFER, oldVBuffer);
         }
       } else {
         valid = false;
@@ -18,19 +18,21 @@
 
 #include <vector>
 #include "Common.hpp"
+#include "GLState.hpp"
+#include "StreamBuffer.hpp"
 #include "Vertex.hpp"
 
 namespace io {
   class Mesh {
   public:
     Mesh()
-      : bufferID(0), meshType(GL_INVALID_ENUM), open(false), valid(false) {
+      : bufferID(0), meshType(GL_INVALID_ENUM), open(false), valid(false),
+        stream(nullptr), streamed(false), streamOffset(0) {
     }
 
     ~Mesh() {
       if (bufferID != 0) {
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        glDeleteBuffers(1, &bufferID);
+        GLState::getInstance()->deleteBuffer(bufferID);
       }
     }
 
@@ -53,12 +55,39 @@ namespace io {
     void begin(GLenum meshType);
 
     void draw() const {
-      if (!isOpen() && bufferID != 0) {
-        glBindBuffer(GL_ARRAY_BUFFER, bufferID);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)0);
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)sizeof(Vector3));
-        glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_FALSE, sizeof(Vertex), (GLvoid*)(sizeof(Vector3) + sizeof(Vector2)));
+      if (!isOpen() && hasBuffer()) {
+        bindAttributes();
         glDrawArrays(meshType, 0, vertices.size());
+        GLState::getInstance()->recordDraw(vertices.size());
+      }
+    }
+
+    /**
+     * Draws the mesh instanceCount times.  Per-instance attributes must
+     * already be set up by the caller.
+     */
+    void drawInstanced(const GLsizei instanceCount) const {
+      if (!isOpen() && hasBuffer() && instanceCount > 0) {
+        bindAttributes();
+        glDrawArraysInstancedARB(meshType, 0, vertices.size(), instanceCount);
+        GLState::getInstance()->recordDraw(vertices.size() * instanceCount);
+      }
+    }
+
+    /**
+     * Draws several runs of vertices out of the mesh with a single call.
+     * firsts and counts must be the same length.
+     */
+    void drawRanges(const std::vector<GLint>& firsts, const std::vector<GLsizei>& counts) const {
+      if (!isOpen() && hasBuffer() && firsts.size() > 0) {
+        bindAttributes();
+        glMultiDrawArrays(meshType, firsts.data(), counts.data(), firsts.size());
+
+        GLsizei total = 0;
+        for (GLsizei count : counts) {
+          total += count;
+        }
+        GLState::getInstance()->recordDraw(total);
       }
     }
 
@@ -68,6 +97,10 @@ namespace io {
       return meshType;
     }
 
+    std::size_t getVertexCount() const {
+      return vertices.size();
+    }
+
     const std::vector<Vertex>& getVertices() const {
       return vertices;
     }
@@ -79,6 +112,15 @@ namespace io {
     bool isValid() const {
       return valid;
     }
+
+    /**
+     * Meshes with a stream buffer are written into it by end(), rather than
+     * into a buffer of their own, and can only be drawn until the end of
+     * the frame.  For meshes that are rebuilt every frame.
+     */
+    void setStreamBuffer(StreamBuffer* stream) {
+      this->stream = stream;
+    }
   private:
     GLuint bufferID;
     GLenum meshType;
@@ -86,8 +128,25 @@ namespace io {
     bool valid;
     std::vector<Vertex> vertices;
 
+    StreamBuffer* stream;
+    bool streamed;
+    uint32_t streamOffset;
+
     Mesh(const Mesh&);
     Mesh& operator=(const Mesh&);
+
+    void bindAttributes() const {
+      GLuint buffer = streamed ? stream->getBufferID() : bufferID;
+      uintptr_t offset = streamed ? streamOffset : 0;
+      GLState::getInstance()->bindArrayBuffer(buffer);
+      glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)offset);
+      glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)(offset + sizeof(Vector3)));
+      glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (GLvoid*)(offset + sizeof(Vector3) + sizeof(Vector2)));
+    }
+
+    bool hasBuffer() const {
+      return streamed || bufferID != 0;
+    }
   };
 }
 
@@ -0,0 +1,42 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#include "PagedShelfPacker.hpp"
+
+namespace io {
+  PagedShelfPacker::~PagedShelfPacker() {
+    for (ShelfPacker* packer : packers) {
+      delete packer;
+    }
+    packers.clear();
+  }
+
+  bool PagedShelfPacker::pack(const uint32_t w, const uint32_t h, uint32_t& page, uint32_t& x, uint32_t& y) {
+    if (w > pageWidth || h > pageHeight) {
+      return false;
+    }
+
+    //  Earlier pages can still have room on their shelves for small things.
+    for (page = 0; page < packers.size(); page++) {
+      if (packers[page]->pack(w, h, x, y)) {
+        return true;
+      }
+    }
+
+    ShelfPacker* packer = new ShelfPacker(pageWidth, pageHeight);
+    packers.push_back(packer);
+    return packer->pack(w, h, x, y);
+  }
+}
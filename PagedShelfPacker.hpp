@@ -0,0 +1,58 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#ifndef PagedShelfPackerHPP
+#define PagedShelfPackerHPP
+
+#include <cstdint>
+#include <vector>
+#include "ShelfPacker.hpp"
+
+namespace io {
+  /**
+   * Shelf packs rectangles across any number of equally sized pages.  Each
+   * rectangle goes on the first page with room for it, and a new page is
+   * opened when none has any.  The pages themselves, and whatever is drawn
+   * on them, belong to the caller.
+   */
+  class PagedShelfPacker {
+  public:
+    PagedShelfPacker(const uint32_t pageWidth, const uint32_t pageHeight)
+      : pageWidth(pageWidth), pageHeight(pageHeight) {
+    }
+
+    ~PagedShelfPacker();
+
+    uint32_t getPageCount() const {
+      return packers.size();
+    }
+
+    /**
+     * Finds room for a w x h rectangle.  Returns false if it is bigger than
+     * a page, otherwise the page and its top left corner go in page, x and
+     * y.  A page equal to the old page count is a new one.
+     */
+    bool pack(const uint32_t w, const uint32_t h, uint32_t& page, uint32_t& x, uint32_t& y);
+  private:
+    uint32_t pageWidth;
+    uint32_t pageHeight;
+    std::vector<ShelfPacker*> packers;
+
+    PagedShelfPacker(const PagedShelfPacker&);
+    PagedShelfPacker& operator=(const PagedShelfPacker&);
+  };
+}
+
+#endif // PagedShelfPackerHPP
@@ -0,0 +1,322 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#include "PotentiallyVisibleSet.hpp"
+#include "Map.hpp"
+#include "Log.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+
+namespace io {
+  const char PVS_MAGIC[4] = { 'I', 'O', 'P', 'V' };
+
+  void writeVarint(std::vector<uint8_t>& out, uint32_t value);
+  bool readVarint(const uint8_t*& in, const uint8_t* end, uint32_t& value);
+
+  PotentiallyVisibleSet* PotentiallyVisibleSet::build(Map* map, uint32_t threadCount) {
+    if (threadCount == 0) {
+      threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    PotentiallyVisibleSet* pvs = new PotentiallyVisibleSet(map->getWidth(), map->getHeight(), map->getLayoutHash());
+    uint32_t entryCount = map->getWidth() * map->getHeight() * PotentiallyVisibleSet::FACING_COUNT;
+
+    //  Each thread takes every threadCount'th cell, and only ever writes to
+    //  the entries of its own cells.  The map is only read.
+    std::vector<std::vector<uint8_t>> entries(entryCount);
+    std::vector<std::thread> workers;
+    for (uint32_t t = 0; t < threadCount; t++) {
+      workers.push_back(std::thread([map, &entries, t, threadCount]() {
+        CellVisibility visibility(map->getWidth(), map->getHeight());
+        uint32_t cellCount = map->getWidth() * map->getHeight();
+
+        for (uint32_t cell = t; cell < cellCount; cell += threadCount) {
+          int32_t x = cell % map->getWidth();
+          int32_t y = cell / map->getWidth();
+          if (map->isSolid(x, y)) {
+            continue;
+          }
+
+          for (uint32_t f = 0; f < PotentiallyVisibleSet::FACING_COUNT; f++) {
+            map->computeVisibility(&visibility, x, y, static_cast<Facing>(f));
+            encode(visibility, entries[(cell * PotentiallyVisibleSet::FACING_COUNT) + f]);
+          }
+        }
+      }));
+    }
+
+    for (std::thread& worker : workers) {
+      worker.join();
+    }
+
+    for (const std::vector<uint8_t>& entry : entries) {
+      pvs->offsets.push_back(pvs->data.size());
+      pvs->data.insert(pvs->data.end(), entry.begin(), entry.end());
+    }
+    pvs->offsets.push_back(pvs->data.size());
+
+    return pvs;
+  }
+
+  PotentiallyVisibleSet* PotentiallyVisibleSet::load(const std::string& filename, Map* map) {
+    PotentiallyVisibleSet* pvs = nullptr;
+    std::ifstream file;
+    file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+
+    try {
+      file.open(filename.c_str(), std::ios::binary | std::ios::in);
+
+      char magic[4];
+      uint32_t version = 0;
+      int32_t width = 0;
+      int32_t height = 0;
+      uint32_t mapHash = 0;
+      uint32_t dataSize = 0;
+      file.read(magic, sizeof(magic));
+      file.read((char*)&version, sizeof(version));
+      file.read((char*)&width, sizeof(width));
+      file.read((char*)&height, sizeof(height));
+      file.read((char*)&mapHash, sizeof(mapHash));
+      file.read((char*)&dataSize, sizeof(dataSize));
+
+      if (::memcmp(magic, PVS_MAGIC, sizeof(magic)) != 0 ||
+          version != PotentiallyVisibleSet::VERSION) {
+        throw std::runtime_error("PotentiallyVisibleSet::load():  Not a PVS file, or an old one.");
+      }
+
+      if (width != map->getWidth() || height != map->getHeight() ||
+          mapHash != map->getLayoutHash()) {
+        throw std::runtime_error("PotentiallyVisibleSet::load():  PVS was built for a different map.");
+      }
+
+      //  The sizes are checked against the file before anything is
+      //  allocated for them.
+      uint64_t offsetCount = ((uint64_t)width * height * PotentiallyVisibleSet::FACING_COUNT) + 1;
+      std::streampos payloadStart = file.tellg();
+      file.seekg(0, std::ios::end);
+      uint64_t payloadSize = file.tellg() - payloadStart;
+      file.seekg(payloadStart);
+      if (payloadSize != (offsetCount * sizeof(uint32_t)) + dataSize) {
+        throw std::runtime_error("PotentiallyVisibleSet::load():  PVS file is the wrong size.");
+      }
+
+      pvs = new PotentiallyVisibleSet(width, height, mapHash);
+      pvs->offsets.resize(offsetCount);
+      pvs->data.resize(dataSize);
+      file.read((char*)pvs->offsets.data(), pvs->offsets.size() * sizeof(uint32_t));
+      if (dataSize > 0) {
+        file.read((char*)pvs->data.data(), dataSize);
+      }
+
+      if (!pvs->isValid()) {
+        throw std::runtime_error("PotentiallyVisibleSet::load():  PVS file is damaged.");
+      }
+
+      file.close();
+    }
+    catch (std::exception& e) {
+      if (pvs) {
+        delete pvs;
+        pvs = nullptr;
+      }
+
+      if (file.is_open()) {
+        file.close();
+      }
+
+      writeToLog(MessageLevel::WARNING, "Could not load PVS \"%s\":  %s\n", filename.c_str(), e.what());
+    }
+
+    return pvs;
+  }
+
+  /**
+   * FNV-1a over the solidity of every cell.  Visibility depends on nothing
+   * else, so this is enough to tell whether a saved set still applies.
+   */
+  uint32_t PotentiallyVisibleSet::hashMap(Map* map) {
+    uint32_t hash = 2166136261u;
+    for (int32_t y = 0; y < map->getHeight(); y++) {
+      for (int32_t x = 0; x < map->getWidth(); x++) {
+        hash ^= map->isSolid(x, y) ? 1 : 0;
+        hash *= 16777619u;
+      }
+    }
+
+    return hash;
+  }
+
+  void PotentiallyVisibleSet::decode(CellVisibility* out, const int32_t x, const int32_t y, const Facing facing) const {
+    out->clear();
+    if (x < 0 || y < 0 || x >= width || y >= height) {
+      return;
+    }
+
+    uint32_t entry = (((y * width) + x) * PotentiallyVisibleSet::FACING_COUNT) + static_cast<uint32_t>(facing);
+    const uint8_t* in = data.data() + offsets[entry];
+    const uint8_t* end = data.data() + offsets[entry + 1];
+
+    uint32_t cell = 0;
+    uint32_t skip = 0;
+    uint32_t run = 0;
+    while (readVarint(in, end, skip) && readVarint(in, end, run)) {
+      cell += skip;
+      for (uint32_t i = 0; i < run; i++, cell++) {
+        out->markVisible(cell % width, cell / width);
+      }
+    }
+  }
+
+  uint32_t PotentiallyVisibleSet::getEncodedSize() const {
+    return sizeof(PVS_MAGIC) + (sizeof(uint32_t) * 5) +
+           (offsets.size() * sizeof(uint32_t)) + data.size();
+  }
+
+  bool PotentiallyVisibleSet::isBuiltFor(Map* map) const {
+    return (map->getWidth() == width && map->getHeight() == height &&
+            map->getLayoutHash() == mapHash);
+  }
+
+  /**
+   * Checks everything decode() trusts: that the entries are laid end to end
+   * within the data, and that each one is whole and stays within the map.
+   */
+  bool PotentiallyVisibleSet::isValid() const {
+    if (offsets.empty() || offsets.front() != 0 || offsets.back() != data.size()) {
+      return false;
+    }
+
+    for (uint32_t i = 1; i < offsets.size(); i++) {
+      if (offsets[i] < offsets[i - 1]) {
+        return false;
+      }
+    }
+
+    uint64_t cellCount = (uint64_t)width * height;
+    for (uint32_t i = 0; i + 1 < offsets.size(); i++) {
+      const uint8_t* in = data.data() + offsets[i];
+      const uint8_t* end = data.data() + offsets[i + 1];
+
+      uint64_t cell = 0;
+      uint32_t skip = 0;
+      uint32_t run = 0;
+      while (in < end) {
+        if (!readVarint(in, end, skip) || !readVarint(in, end, run)) {
+          return false;
+        }
+
+        cell += (uint64_t)skip + run;
+        if (cell > cellCount) {
+          return false;
+        }
+      }
+    }
+
+    return true;
+  }
+
+  bool PotentiallyVisibleSet::save(const std::string& filename) const {
+    std::ofstream file;
+    file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+
+    try {
+      file.open(filename.c_str(), std::ios::binary | std::ios::out | std::ios::trunc);
+
+      uint32_t version = PotentiallyVisibleSet::VERSION;
+      uint32_t dataSize = data.size();
+      file.write(PVS_MAGIC, sizeof(PVS_MAGIC));
+      file.write((const char*)&version, sizeof(version));
+      file.write((const char*)&width, sizeof(width));
+      file.write((const char*)&height, sizeof(height));
+      file.write((const char*)&mapHash, sizeof(mapHash));
+      file.write((const char*)&dataSize, sizeof(dataSize));
+      file.write((const char*)offsets.data(), offsets.size() * sizeof(uint32_t));
+      if (dataSize > 0) {
+        file.write((const char*)data.data(), dataSize);
+      }
+
+      file.close();
+    }
+    catch (std::exception& e) {
+      if (file.is_open()) {
+        file.close();
+      }
+
+      writeToLog(MessageLevel::WARNING, "Could not save PVS \"%s\":  %s\n", filename.c_str(), e.what());
+      return false;
+    }
+
+    return true;
+  }
+
+  /**
+   * Writes alternating runs of hidden and visible cells.  Trailing hidden
+   * cells are left off, so a set with nothing visible takes no space at all.
+   */
+  void PotentiallyVisibleSet::encode(const CellVisibility& visibility, std::vector<uint8_t>& out) {
+    std::vector<uint32_t> cells = visibility.getVisibleCells();
+    std::sort(cells.begin(), cells.end());
+
+    out.clear();
+    uint32_t position = 0;
+    std::size_t i = 0;
+    while (i < cells.size()) {
+      uint32_t runStart = cells[i];
+      uint32_t runEnd = runStart + 1;
+      i++;
+
+      while (i < cells.size() && cells[i] == runEnd) {
+        runEnd++;
+        i++;
+      }
+
+      writeVarint(out, runStart - position);
+      writeVarint(out, runEnd - runStart);
+      position = runEnd;
+    }
+  }
+
+  void writeVarint(std::vector<uint8_t>& out, uint32_t value) {
+    while (value >= 0x80) {
+      out.push_back((value & 0x7F) | 0x80);
+      value >>= 7;
+    }
+
+    out.push_back(value);
+  }
+
+  /**
+   * Returns false, leaving value alone, if the varint runs past end or is
+   * too long to be a 32-bit value.
+   */
+  bool readVarint(const uint8_t*& in, const uint8_t* end, uint32_t& value) {
+    uint32_t result = 0;
+    const uint8_t* position = in;
+    for (uint32_t shift = 0; shift < 35 && position < end; shift += 7) {
+      uint8_t byte = *position++;
+      result |= (uint32_t)(byte & 0x7F) << shift;
+      if ((byte & 0x80) == 0) {
+        in = position;
+        value = result;
+        return true;
+      }
+    }
+
+    return false;
+  }
+}
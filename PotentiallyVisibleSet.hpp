@@ -0,0 +1,88 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#ifndef PotentiallyVisibleSetHPP
+#define PotentiallyVisibleSetHPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Common.hpp"
+#include "CellVisibility.hpp"
+
+namespace io {
+  class Map;
+
+  /**
+   * The precomputed visibility of every cell of a map, from every cell and
+   * facing.  Each set is stored run-length encoded: alternating runs of
+   * hidden and visible cells, in cell index order, as variable length
+   * integers.  Sets can be saved alongside the floor they belong to, and are
+   * tied to it by a hash of the floor's solid cells.
+   */
+  class PotentiallyVisibleSet {
+  public:
+    /**
+     * Computes the visibility of every cell and facing of the map, spread
+     * over the given number of threads.  A thread count of 0 uses one thread
+     * per hardware thread.
+     */
+    static PotentiallyVisibleSet* build(Map* map, uint32_t threadCount = 0);
+
+    /**
+     * Loads a set from disk.  Returns nullptr if the file is missing,
+     * damaged, or was built for a different layout of the map.  Every entry
+     * is checked before the set is handed back.
+     */
+    static PotentiallyVisibleSet* load(const std::string& filename, Map* map);
+
+    //  Hashes the solid cells of the map.  Use Map::getLayoutHash(), which
+    //  only does this again once the map has changed.
+    static uint32_t hashMap(Map* map);
+
+    void decode(CellVisibility* out, const int32_t x, const int32_t y, const Facing facing) const;
+
+    //  The size of the set as saved by save(), in bytes.
+    uint32_t getEncodedSize() const;
+
+    //  Whether the set still matches the solid cells of the map.
+    bool isBuiltFor(Map* map) const;
+
+    bool save(const std::string& filename) const;
+  private:
+    const static uint32_t VERSION = 1;
+    const static uint32_t FACING_COUNT = 4;
+
+    PotentiallyVisibleSet(const int32_t width, const int32_t height, const uint32_t mapHash)
+      : width(width), height(height), mapHash(mapHash) {
+    }
+
+    PotentiallyVisibleSet(const PotentiallyVisibleSet&) = delete;
+    PotentiallyVisibleSet& operator=(const PotentiallyVisibleSet&) = delete;
+
+    int32_t width;
+    int32_t height;
+    uint32_t mapHash;
+
+    //  Entry i occupies data[offsets[i]] up to data[offsets[i + 1]].
+    std::vector<uint32_t> offsets;
+    std::vector<uint8_t> data;
+
+    static void encode(const CellVisibility& visibility, std::vector<uint8_t>& out);
+    bool isValid() const;
+  };
+}
+
+#endif // PotentiallyVisibleSetHPP
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#include "RenderQueue.hpp"
+#include <algorithm>
+
+namespace io {
+  uint64_t RenderQueue::makeKey(const RenderPass pass, const GLuint program, const GLuint texture, const float depth, const uint32_t sequence) {
+    float clamped = std::min(std::max(depth, 0.0f), (float)RenderQueue::MAX_DEPTH);
+    uint64_t quantized = (uint64_t)((clamped / RenderQueue::MAX_DEPTH) * 0xFFFFFF);
+
+    if (pass == RenderPass::OPAQUE) {
+      return (((uint64_t)pass & 0x3) << 62) |
+             (((uint64_t)program & 0xFF) << 54) |
+             (((uint64_t)texture & 0xFFFF) << 38) |
+             (quantized << 14) |
+             ((uint64_t)sequence & 0x3FFF);
+    }
+
+    return (((uint64_t)pass & 0x3) << 62) |
+           ((0xFFFFFF - quantized) << 38) |
+           ((uint64_t)sequence & 0x3FFFFFFFFFull);
+  }
+
+  void RenderQueue::push(const RenderCommand& command, const RenderPass pass, const float depth) {
+    uint32_t index = commands.size();
+    commands.push_back(command);
+    order.push_back(std::make_pair(makeKey(pass, command.program, command.texture, depth, index), index));
+  }
+
+  const std::vector<std::pair<uint64_t, uint32_t>>& RenderQueue::sort() {
+    std::sort(order.begin(), order.end());
+    return order;
+  }
+}
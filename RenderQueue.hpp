@@ -0,0 +1,123 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#ifndef RenderQueueHPP
+#define RenderQueueHPP
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "Colour.hpp"
+#include "Common.hpp"
+#include "Matrix.hpp"
+#include "ShaderVariants.hpp"
+#include "TileInstance.hpp"
+
+namespace io {
+  class FloorGeometry;
+  class Mesh;
+  class SpriteBatch;
+
+  enum class BlendMode : uint8_t {
+    OPAQUE,
+    //  Source scaled by the blend colour, as text is drawn.
+    CONSTANT_COLOUR,
+    //  Source already multiplied by its own alpha, as the sprite batch draws.
+    PREMULTIPLIED_ALPHA
+  };
+
+  enum class RenderPass : uint8_t {
+    OPAQUE,
+    TRANSLUCENT
+  };
+
+  /**
+   * Everything needed to make one draw later on.  Exactly one of mesh,
+   * geometry and batch is set.  If instances is set, mesh is drawn once per
+   * instance.  If batch is set, batchRange is the range of it to draw.
+   * features are the ShaderFeatures the draw needs, which the generic
+   * variant is told about if it stands in for the program.
+   */
+  struct RenderCommand {
+    RenderCommand()
+      : mesh(nullptr), geometry(nullptr), instances(nullptr), batch(nullptr),
+        batchRange(0), features(ShaderFeatures::TEXTURED), program(0), texture(0), blendMode(BlendMode::OPAQUE) {
+    }
+
+    const Mesh* mesh;
+    const FloorGeometry* geometry;
+    const std::vector<TileInstance>* instances;
+    SpriteBatch* batch;
+    uint32_t batchRange;
+
+    uint32_t features;
+    GLuint program;
+    GLuint texture;
+    BlendMode blendMode;
+    Colour blendColour;
+
+    Matrix modelMatrix;
+    Matrix viewMatrix;
+    Matrix projectionMatrix;
+  };
+
+  /**
+   * Collects the draws of a frame so they can be made in a better order than
+   * they were asked for in.  Each command gets a 64-bit key when it's pushed,
+   * and sorting the keys gives the order to draw in:
+   *
+   *   Opaque:       pass(2) program(8) texture(16) depth(24) sequence(14)
+   *   Translucent:  pass(2) inverted depth(24) sequence(38)
+   *
+   * Opaque draws are grouped by state, then drawn front to back so that the
+   * depth test throws away as much as possible.  Translucent draws go back
+   * to front, and draws at the same depth, like the UI, keep the order they
+   * were pushed in.
+   */
+  class RenderQueue {
+  public:
+    //  Depths past this all sort the same.
+    const static uint32_t MAX_DEPTH = 512;
+
+    void clear() {
+      commands.clear();
+      order.clear();
+    }
+
+    const RenderCommand& getCommand(const uint32_t index) const {
+      return commands[index];
+    }
+
+    uint32_t getCommandCount() const {
+      return commands.size();
+    }
+
+    static uint64_t makeKey(const RenderPass pass, const GLuint program, const GLuint texture, const float depth, const uint32_t sequence);
+
+    /**
+     * Adds a command.  depth is the distance of the thing being drawn from
+     * the camera.
+     */
+    void push(const RenderCommand& command, const RenderPass pass, const float depth);
+
+    //  Returns the command indices in the order they should be drawn.
+    const std::vector<std::pair<uint64_t, uint32_t>>& sort();
+  private:
+    std::vector<RenderCommand> commands;
+    std::vector<std::pair<uint64_t, uint32_t>> order;
+  };
+}
+
+#endif // RenderQueueHPP
@@ -0,0 +1,41 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#include "RenderTarget.hpp"
+#include "GLState.hpp"
+#include "Log.hpp"
+
+namespace io {
+  RenderTarget::RenderTarget(const uint32_t width, const uint32_t height) {
+    texture = new Texture(width, height, TextureFormat::RGBA);
+
+    GLState* state = GLState::getInstance();
+    glGenFramebuffers(1, &framebufferID);
+    state->bindFramebuffer(framebufferID);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture->getTextureID(), 0);
+
+    complete = (glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+    if (!complete) {
+      writeToLog(MessageLevel::WARNING, "Could not create a %ux%u render target.\n", width, height);
+    }
+
+    state->bindFramebuffer(0);
+  }
+
+  RenderTarget::~RenderTarget() {
+    GLState::getInstance()->deleteFramebuffer(framebufferID);
+    delete texture;
+  }
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#ifndef RenderTargetHPP
+#define RenderTargetHPP
+
+#include <cstdint>
+#include "Common.hpp"
+#include "Texture.hpp"
+
+namespace io {
+  /**
+   * An RGBA texture that can be drawn into, through a framebuffer object.
+   * See Graphics::beginRenderTarget().
+   */
+  class RenderTarget {
+  public:
+    RenderTarget(const uint32_t width, const uint32_t height);
+    ~RenderTarget();
+
+    GLuint getFramebufferID() const {
+      return framebufferID;
+    }
+
+    uint32_t getHeight() const {
+      return texture->getHeight();
+    }
+
+    //  Rows are bottom up, as GL draws them.
+    Texture* getTexture() const {
+      return texture;
+    }
+
+    uint32_t getWidth() const {
+      return texture->getWidth();
+    }
+
+    //  False if the driver wouldn't accept the framebuffer.
+    bool isComplete() const {
+      return complete;
+    }
+  private:
+    GLuint framebufferID;
+    Texture* texture;
+    bool complete;
+
+    RenderTarget(const RenderTarget&);
+    RenderTarget& operator=(const RenderTarget&);
+  };
+}
+
+#endif // RenderTargetHPP
@@ -33,6 +33,7 @@ namespace io {
 
   ResourceManager::ResourceManager() {
     FT_Init_FreeType(&ftLib);
+    fontRenderMode = FontRenderMode::BITMAP;
   }
 
   ResourceManager::~ResourceManager() {
@@ -54,8 +55,9 @@ namespace io {
       }
 
       if (p.extension().compare(".ttf") == 0) {
-        // For now, we only load fonts at 24 point.
-        Font* newFont = new Font(ftLib, resource);
+        //  Text is laid out at 24 pixels unless asked otherwise.  Distance
+        //  field fonts draw any size from the same glyphs.
+        Font* newFont = new Font(ftLib, resource, fontRenderMode);
         newFont->setPixelSize(24);
         ret = newFont;
       }
@@ -16,12 +16,15 @@
 #ifndef ResourceManagerHPP
 #define ResourceManagerHPP
 
+#include <cstdint>
 #include <map>
 #include <string>
 #include <vector>
 #include "Resource.hpp"
 
 namespace io {
+  enum class FontRenderMode : uint8_t;
+
   class ResourceManager {
   public:
     static void deleteInstance() {
@@ -35,6 +38,10 @@ namespace io {
       return classes;
     }
 
+    FontRenderMode getFontRenderMode() const {
+      return fontRenderMode;
+    }
+
     static ResourceManager* getInstance() {
       if (!ResourceManager::instance) {
         ResourceManager::instance = new ResourceManager();
@@ -56,11 +63,17 @@ namespace io {
 
       return ret;
     }
+
+    //  Only affects fonts loaded after it's set.
+    void setFontRenderMode(const FontRenderMode mode) {
+      fontRenderMode = mode;
+    }
   private:
     static ResourceManager* instance;
 
     std::map<std::string, Resource*> resources;
     std::vector<Class*> classes;
+    FontRenderMode fontRenderMode;
 
     ResourceManager();
     ~ResourceManager();
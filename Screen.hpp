@@ -19,6 +19,7 @@
 #include "Graphics.hpp"
 #include "Component.hpp"
 #include "InputEvent.hpp"
+#include "RenderTarget.hpp"
 #include <list>
 #include <iostream>
 
@@ -36,13 +37,21 @@ namespace io {
   class Screen {
   public:
     Screen() {
+      cache = nullptr;
+      cacheEnabled = true;
+      cacheValid = false;
       focusedComponent = nullptr;
     }
     
     virtual ~Screen() {
+      delete cache;
     }
     
     void activated() {
+      //  Other screens may have been drawn since, so everything could look
+      //  different.
+      cacheValid = false;
+
       for (ScreenEventListener* l : screenEventListeners) {
         l->onScreenActivated(this);
       }
@@ -51,6 +60,7 @@ namespace io {
     void addComponent(Component* component) {
       if (component && !hasComponent(component)) {
         components.push_back(component);
+        cacheValid = false;
       }
     }
     
@@ -72,6 +82,11 @@ namespace io {
       }
     }
 
+    /**
+     * Draws the components into a texture, and puts that on the screen.  The
+     * texture is only drawn again when a component has changed, so a screen
+     * that sits still costs one quad a frame.
+     */
     void draw(Graphics* g) {
       g->setMatrixMode(MatrixMode::VIEW);
       g->pushMatrix();
@@ -82,8 +97,27 @@ namespace io {
       g->loadIdentity();
       g->ortho(0, 640, 480, 0, 0, 1);
       
-      for (Component* c : components) {
-        c->draw(g);
+      if (isCacheEnabled() && g->isRenderTargetSupported()) {
+        if (!cache) {
+          cache = new RenderTarget(640, 480);
+        }
+
+        if (!cacheValid || isDirty()) {
+          g->beginRenderTarget(cache);
+          drawComponents(g);
+          g->endRenderTarget();
+          g->getFrameStatistics().screensRedrawn++;
+
+          for (Component* c : components) {
+            c->markClean();
+          }
+          cacheValid = true;
+        }
+
+        g->drawRenderTarget(cache, 0.0f, 0.0f, 640.0f, 480.0f);
+      }
+      else {
+        drawComponents(g);
       }
       
       g->setMatrixMode(MatrixMode::PROJECTION);
@@ -108,9 +142,14 @@ namespace io {
       return handleInputEventListeners(event);
     }
 
+    bool isCacheEnabled() const {
+      return cacheEnabled;
+    }
+
     void removeComponent(Component* component) {
       if (component && hasComponent(component)) {
         components.remove(component);
+        cacheValid = false;
       }
     }
 
@@ -126,6 +165,12 @@ namespace io {
       }
     }
 
+    //  Screens that change every frame gain nothing from the cache.
+    void setCacheEnabled(const bool enabled) {
+      cacheEnabled = enabled;
+      cacheValid = false;
+    }
+
     void setFocusedComponent(Component* component) {
       if (component) {
         if (hasComponent(component)) {
@@ -137,11 +182,27 @@ namespace io {
       }
     }
   private:
+    RenderTarget* cache;
+    bool cacheEnabled;
+    bool cacheValid;
     std::list<Component*> components;
     Component* focusedComponent;
     std::list<InputEventListener*> inputEventListeners;
     std::list<ScreenEventListener*> screenEventListeners;
 
+    Screen(const Screen&);
+    Screen& operator=(const Screen&);
+
+    void drawComponents(Graphics* g) {
+      //  The whole screen goes into one batch, so that it takes a handful
+      //  of draws rather than one per glyph run.
+      g->beginBatch();
+      for (Component* c : components) {
+        c->draw(g);
+      }
+      g->endBatch();
+    }
+
     bool handleInputEventListeners(const InputEvent& event) {
       for (InputEventListener* l : inputEventListeners) {
         bool result = l->handleInputEvent(event);
@@ -182,6 +243,16 @@ namespace io {
 
       return false;
     }
+
+    bool isDirty() const {
+      for (Component* c : components) {
+        if (c->isDirty()) {
+          return true;
+        }
+      }
+
+      return false;
+    }
   };
 }
 
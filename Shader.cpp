@@ -19,7 +19,7 @@
 #include "Shader.hpp"
 
 namespace io {
-  void Shader::loadShaderFromFile(const std::string& filename) {
+  void Shader::loadShaderFromFile(const std::string& filename, const std::string& preamble) {
     char* buffer = nullptr;
     std::ifstream file;
     file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
@@ -44,11 +44,11 @@ namespace io {
       file.close();
 
       std::string text(buffer);
-      this->loadShaderFromText(text);
+      this->loadShaderFromText(preamble + text);
 
       delete [] buffer;
       buffer = NULL;
-    } catch (const std::exception& e) {
+    } catch (...) {
       if (buffer) {
         delete [] buffer;
         buffer = nullptr;
@@ -58,11 +58,25 @@ namespace io {
         file.close();
       }
 
-      throw e;
+      throw;
     }
   }
 
   void Shader::loadShaderFromText(const std::string& text) {
+    if (this->shaderID != 0) {
+      glDeleteShader(this->shaderID);
+      this->shaderID = 0;
+    }
+
+    this->compiled = false;
+    this->source = text;
+  }
+
+  void Shader::beginCompile() {
+    if (this->shaderID != 0) {
+      return;
+    }
+
     GLuint shaderID = 0;
     try {
       //  Clear GL error flag..
@@ -73,30 +87,41 @@ namespace io {
         throw std::runtime_error("Unknown error creating a shader object.");
       }
 
-      const GLchar* textBuffer = const_cast<const GLchar*>(text.c_str());
-      const GLint size = text.length();
+      const GLchar* textBuffer = const_cast<const GLchar*>(source.c_str());
+      const GLint size = source.length();
       glShaderSource(shaderID, 1, &textBuffer, &size);
       if (glGetError() != GL_NO_ERROR) {
         throw std::runtime_error("Unknown error reading in shader source.");
       }
 
       glCompileShader(shaderID);
-      GLint status = GL_TRUE;
-      glGetShaderiv(shaderID, GL_COMPILE_STATUS, (GLint*)&status);
-
-      if (!(glGetError() == GL_NO_ERROR && status == GL_TRUE)) {
-        char infoLog[1024];
-        glGetShaderInfoLog(shaderID, 1024, NULL, infoLog);
-        throw std::runtime_error(std::string(infoLog));
-      }
-
       this->shaderID = shaderID;
-    } catch (const std::exception& e) {
+    } catch (...) {
       if (shaderID != 0) {
         glDeleteShader(shaderID);
       }
 
-      throw e;
+      throw;
+    }
+  }
+
+  void Shader::finishCompile() {
+    if (isCompiled() || this->shaderID == 0) {
+      return;
     }
+
+    //  Asking for the status waits for the compile, if it's still going.
+    GLint status = GL_TRUE;
+    glGetShaderiv(this->shaderID, GL_COMPILE_STATUS, (GLint*)&status);
+
+    if (!(glGetError() == GL_NO_ERROR && status == GL_TRUE)) {
+      char infoLog[1024];
+      glGetShaderInfoLog(this->shaderID, 1024, NULL, infoLog);
+      glDeleteShader(this->shaderID);
+      this->shaderID = 0;
+      throw std::runtime_error(std::string(infoLog));
+    }
+
+    compiled = true;
   }
 }
@@ -20,9 +20,13 @@
 #include "Common.hpp"
 
 namespace io {
+  /**
+   * Shader source, compiled when a program first needs it.  A program
+   * loaded from the binary cache never does, see ShaderProgram::link().
+   */
   class Shader {
   public:
-    Shader() : shaderID(0) {
+    Shader() : compiled(false), shaderID(0) {
     }
 
     virtual ~Shader() {
@@ -31,15 +35,41 @@ namespace io {
       }
     }
 
+    /**
+     * Hands the source to the driver, without waiting to hear whether it
+     * compiled.  finishCompile() waits and throws if it didn't.  Both do
+     * nothing once the shader has compiled.
+     */
+    void beginCompile();
+    void finishCompile();
+
+    //  Does nothing if it's already compiled.  Throws if it won't compile.
+    void compile() {
+      beginCompile();
+      finishCompile();
+    }
+
     GLuint getShaderID() const {
       return this->shaderID;
     }
 
     virtual GLenum getShaderType() const = 0;
-    void loadShaderFromFile(const std::string& filename);
+
+    const std::string& getSource() const {
+      return this->source;
+    }
+
+    bool isCompiled() const {
+      return compiled;
+    }
+
+    //  preamble goes in front of the file, for #extension and #define lines.
+    void loadShaderFromFile(const std::string& filename, const std::string& preamble = std::string());
     void loadShaderFromText(const std::string& text);
   private:
+    bool compiled;
     GLuint shaderID;
+    std::string source;
 
     Shader(const Shader&);
     Shader& operator=(const Shader&);
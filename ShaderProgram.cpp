@@ -13,17 +13,44 @@
  *  See the License for the specific language governing permissions and
  *  limitations under the License.
 */
+#include <chrono>
+#include <cstring>
 #include <exception>
+#include <fstream>
 #include <stdexcept>
+#include <vector>
 #include "ShaderProgram.hpp"
+#include "Log.hpp"
 
 namespace io {
+  const char PROGRAM_CACHE_MAGIC[4] = { 'I', 'O', 'P', 'B' };
+
+  //  FNV-1a, carried on from hash.
+  static uint32_t hashBytes(const char* bytes, const std::size_t length, uint32_t hash) {
+    for (std::size_t i = 0; i < length; i++) {
+      hash ^= (uint8_t)bytes[i];
+      hash *= 16777619u;
+    }
+
+    return hash;
+  }
+
+  static uint32_t hashString(const std::string& text, const uint32_t hash) {
+    //  The terminator keeps "ab" + "c" apart from "a" + "bc".
+    return hashBytes(text.c_str(), text.length() + 1, hash);
+  }
+
   void ShaderProgram::unlink() {
     //  Don't try to unlink a non-existing program, or one that is currently in use.
     if (isProgramValid() && !isProgramActive()) {
       programValid = false;
       while (glGetError() != GL_NO_ERROR);
 
+      //  A program from the cache never had its shaders attached.
+      if (loadedFromCache) {
+        return;
+      }
+
       if (getFragmentShader()) {
         glDetachShader(getProgramID(), getFragmentShader()->getShaderID());
       }
@@ -34,20 +61,31 @@ namespace io {
     }
   }
 
-  void ShaderProgram::link() {
-    GLuint programID = 0;
+  void ShaderProgram::beginLink() {
     try {
-      programValid = true;
+      programValid = false;
+      linkPending = false;
+      loadedFromCache = false;
       while (glGetError() != GL_NO_ERROR);
 
-      if (getProgramID() == 0) {
+      linkStart = std::chrono::steady_clock::now();
+
+      if (programID == 0) {
         programID = glCreateProgram();
         if (glGetError() != GL_NO_ERROR) {
+          programID = 0;
           throw std::runtime_error("ERROR:  Could not create shader program.");
         }
       }
 
+      cacheKey = isCacheUsed() ? getCacheKey() : 0;
+      if (isCacheUsed() && loadBinary(programID, cacheKey)) {
+        loadedFromCache = true;
+        return;
+      }
+
       if (getFragmentShader()) {
+        getFragmentShader()->beginCompile();
         glAttachShader(programID, getFragmentShader()->getShaderID());
         if (glGetError() != GL_NO_ERROR) {
           throw std::runtime_error("ERROR:  Could not attach fragment shader to program.");
@@ -55,6 +93,7 @@ namespace io {
       }
 
       if (getVertexShader()) {
+        getVertexShader()->beginCompile();
         glAttachShader(programID, getVertexShader()->getShaderID());
         if (glGetError() != GL_NO_ERROR) {
           throw std::runtime_error("ERROR:  Could not attach vertex shader to program.");
@@ -70,7 +109,42 @@ namespace io {
           iter++;
         }
 
+        if (isCacheUsed()) {
+          glProgramParameteri(programID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+
         glLinkProgram(programID);
+        linkPending = true;
+      }
+    } catch (...) {
+      linkPending = false;
+      throw;
+    }
+  }
+
+  void ShaderProgram::finishLink() {
+    try {
+      if (loadedFromCache) {
+        programValid = true;
+        reflectUniforms();
+
+        float milliseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - linkStart).count() / 1000.0f;
+        writeToLog(MessageLevel::INFO, "Program cache hit for \"%s\", loaded in %.2fms.\n", cacheFilename.c_str(), milliseconds);
+        return;
+      }
+
+      if (linkPending) {
+        linkPending = false;
+
+        //  A shader that didn't compile says why better than the link does.
+        if (getFragmentShader()) {
+          getFragmentShader()->finishCompile();
+        }
+
+        if (getVertexShader()) {
+          getVertexShader()->finishCompile();
+        }
+
         GLint status = GL_TRUE;
         glGetProgramiv(programID, GL_LINK_STATUS, (GLint*)&status);
 
@@ -81,10 +155,161 @@ namespace io {
         }
       }
 
-      this->programID = programID;
-    } catch(std::exception& e) {
+      programValid = true;
+      reflectUniforms();
+
+      if (isCacheUsed()) {
+        float milliseconds = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - linkStart).count() / 1000.0f;
+        writeToLog(MessageLevel::INFO, "Program cache miss for \"%s\", compiled and linked in %.2fms.\n", cacheFilename.c_str(), milliseconds);
+        saveBinary(cacheKey);
+      }
+    } catch (...) {
       programValid = false;
-      throw e;
+      throw;
+    }
+  }
+
+  /**
+   * Identifies everything that goes into a linked program.  The driver is
+   * included, since a binary is only any good to the driver that made it.
+   */
+  uint32_t ShaderProgram::getCacheKey() const {
+    uint32_t key = 2166136261u;
+    key = hashString(vertShader ? vertShader->getSource() : std::string(), key);
+    key = hashString(fragShader ? fragShader->getSource() : std::string(), key);
+
+    for (const std::pair<const unsigned int, std::string>& binding : bindings) {
+      key = hashBytes((const char*)&binding.first, sizeof(binding.first), key);
+      key = hashString(binding.second, key);
+    }
+
+    for (GLenum name : { GL_VENDOR, GL_RENDERER, GL_VERSION }) {
+      const GLubyte* value = glGetString(name);
+      key = hashString(value ? std::string((const char*)value) : std::string(), key);
+    }
+
+    return key;
+  }
+
+  bool ShaderProgram::isCacheUsed() const {
+    return (!cacheFilename.empty() && GLEW_ARB_get_program_binary);
+  }
+
+  bool ShaderProgram::isLinkComplete() const {
+#ifdef GL_KHR_parallel_shader_compile
+    if (!linkPending || !GLEW_KHR_parallel_shader_compile) {
+      return true;
+    }
+
+    GLint complete = GL_FALSE;
+    glGetProgramiv(programID, GL_COMPLETION_STATUS_KHR, &complete);
+    return (complete == GL_TRUE);
+#else
+    return true;
+#endif
+  }
+
+  bool ShaderProgram::loadBinary(const GLuint programID, const uint32_t key) {
+    std::ifstream file;
+    file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+
+    try {
+      file.open(cacheFilename.c_str(), std::ios::binary | std::ios::in);
+
+      char magic[4];
+      uint32_t version = 0;
+      uint32_t hash = 0;
+      uint32_t format = 0;
+      uint32_t length = 0;
+      file.read(magic, sizeof(magic));
+      file.read((char*)&version, sizeof(version));
+      file.read((char*)&hash, sizeof(hash));
+      file.read((char*)&format, sizeof(format));
+      file.read((char*)&length, sizeof(length));
+
+      if (::memcmp(magic, PROGRAM_CACHE_MAGIC, sizeof(magic)) != 0 ||
+          version != ShaderProgram::PROGRAM_CACHE_VERSION) {
+        throw std::runtime_error("Not a program cache, or an old one.");
+      }
+
+      if (hash != key) {
+        throw std::runtime_error("Program cache was made from different sources or for a different driver.");
+      }
+
+      //  A truncated or corrupt file mustn't get a huge allocation out of
+      //  its length field.
+      std::streampos binaryStart = file.tellg();
+      file.seekg(0, std::ios::end);
+      uint64_t binarySize = file.tellg() - binaryStart;
+      file.seekg(binaryStart);
+      if (length == 0 || binarySize != length) {
+        throw std::runtime_error("Program cache is the wrong size.");
+      }
+
+      std::vector<char> binary(length);
+      file.read(binary.data(), length);
+      file.close();
+
+      //  The driver can still turn it down, after an update say.
+      while (glGetError() != GL_NO_ERROR);
+      glProgramBinary(programID, format, binary.data(), length);
+      GLint status = GL_FALSE;
+      glGetProgramiv(programID, GL_LINK_STATUS, &status);
+      if (glGetError() != GL_NO_ERROR || status != GL_TRUE) {
+        throw std::runtime_error("The driver rejected the program binary.");
+      }
+    }
+    catch (std::exception& e) {
+      if (file.is_open()) {
+        file.close();
+      }
+
+      writeToLog(MessageLevel::INFO, "Could not load program cache \"%s\":  %s\n", cacheFilename.c_str(), e.what());
+      return false;
+    }
+
+    return true;
+  }
+
+  /**
+   * Asks GL for every active uniform once, so that looking one up later
+   * costs a hash table probe instead of a string search in the driver.
+   * Members of uniform blocks have no location, and are left out.
+   */
+  void ShaderProgram::reflectUniforms() {
+    uniforms.clear();
+
+    GLint count = 0;
+    GLint maxLength = 0;
+    glGetProgramiv(getProgramID(), GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(getProgramID(), GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+
+    std::vector<GLchar> name(maxLength + 1);
+    for (GLint i = 0; i < count; i++) {
+      GLsizei length = 0;
+      GLint size = 0;
+      GLenum type = GL_NONE;
+      glGetActiveUniform(getProgramID(), i, name.size(), &length, &size, &type, name.data());
+
+      //  Arrays are reported as their first element, but looked up by name.
+      std::string uniformName(name.data(), length);
+      std::size_t bracket = uniformName.find('[');
+      if (bracket != std::string::npos) {
+        uniformName.erase(bracket);
+      }
+
+      GLint location = glGetUniformLocation(getProgramID(), uniformName.c_str());
+      if (location < 0) {
+        continue;
+      }
+
+      uint32_t hash = UniformName(uniformName).hash;
+      if (uniforms.count(hash) > 0) {
+        writeToLog(MessageLevel::WARNING, "Uniform \"%s\" has the same hash as another, and can't be looked up.\n", uniformName.c_str());
+        continue;
+      }
+
+      uniforms[hash] = location;
     }
   }
 
@@ -103,4 +328,46 @@ namespace io {
 
     return ret;
   }
+
+  bool ShaderProgram::saveBinary(const uint32_t key) const {
+    GLint length = 0;
+    glGetProgramiv(getProgramID(), GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+      writeToLog(MessageLevel::WARNING, "Could not save program cache \"%s\":  The driver has no binary for it.\n", cacheFilename.c_str());
+      return false;
+    }
+
+    GLenum format = 0;
+    std::vector<char> binary(length);
+    glGetProgramBinary(getProgramID(), length, nullptr, &format, binary.data());
+
+    std::ofstream file;
+    file.exceptions(std::ofstream::failbit | std::ofstream::badbit);
+
+    try {
+      file.open(cacheFilename.c_str(), std::ios::binary | std::ios::out | std::ios::trunc);
+
+      uint32_t version = ShaderProgram::PROGRAM_CACHE_VERSION;
+      uint32_t binaryFormat = format;
+      uint32_t binaryLength = length;
+      file.write(PROGRAM_CACHE_MAGIC, sizeof(PROGRAM_CACHE_MAGIC));
+      file.write((const char*)&version, sizeof(version));
+      file.write((const char*)&key, sizeof(key));
+      file.write((const char*)&binaryFormat, sizeof(binaryFormat));
+      file.write((const char*)&binaryLength, sizeof(binaryLength));
+      file.write(binary.data(), binary.size());
+
+      file.close();
+    }
+    catch (std::exception& e) {
+      if (file.is_open()) {
+        file.close();
+      }
+
+      writeToLog(MessageLevel::WARNING, "Could not save program cache \"%s\":  %s\n", cacheFilename.c_str(), e.what());
+      return false;
+    }
+
+    return true;
+  }
 }
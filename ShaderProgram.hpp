@@ -16,24 +16,48 @@
 #ifndef ShaderProgramHPP
 #define ShaderProgramHPP
 
+#include <chrono>
 #include <climits>
+#include <cstdint>
 #include <map>
 #include <string>
+#include <unordered_map>
 #include "Common.hpp"
 #include "FragmentShader.hpp"
+#include "GLState.hpp"
 #include "VertexShader.hpp"
 
 namespace io {
+  /**
+   * The name of a uniform, hashed once when it's made rather than on every
+   * lookup.  Made from a literal in a constant expression, the hash is
+   * worked out by the compiler.
+   */
+  struct UniformName {
+    constexpr UniformName(const char* name) : hash(UniformName::hashOf(name, 2166136261u)) {
+    }
+
+    UniformName(const std::string& name) : hash(UniformName::hashOf(name.c_str(), 2166136261u)) {
+    }
+
+    //  FNV-1a, one character at a time.
+    constexpr static uint32_t hashOf(const char* name, const uint32_t hash) {
+      return (*name == 0) ? hash : UniformName::hashOf(name + 1, (hash ^ (uint8_t)*name) * 16777619u);
+    }
+
+    uint32_t hash;
+  };
+
   class ShaderProgram {
   public:
-    ShaderProgram() : fragShader(nullptr), programID(0), programValid(false), vertShader(nullptr) {
+    ShaderProgram() : cacheKey(0), fragShader(nullptr), linkPending(false), loadedFromCache(false), programID(0), programValid(false), vertShader(nullptr) {
 
     }
 
     ~ShaderProgram() {
       if (programID > 0) {
         unlink();
-        glDeleteProgram(programID);
+        GLState::getInstance()->deleteProgram(programID);
       }
     }
 
@@ -72,8 +96,14 @@ namespace io {
       return programID;
     }
 
-    GLint getUniformLocation(const std::string& uniformName) {
-      return glGetUniformLocation(getProgramID(), uniformName.c_str());
+    //  Looked up in the table made by link().  -1 if there's no such uniform.
+    GLint getUniformLocation(const UniformName& name) const {
+      std::unordered_map<uint32_t, GLint>::const_iterator iter = uniforms.find(name.hash);
+      if (iter != uniforms.end()) {
+        return iter->second;
+      }
+
+      return -1;
     }
 
     VertexShader* getVertexShader() {
@@ -81,26 +111,47 @@ namespace io {
     }
 
     bool isProgramActive() {
-      GLuint state = 0;
-      glGetIntegerv(GL_CURRENT_PROGRAM, (GLint*)&state);
-      return (state == getProgramID());
+      return (GLState::getInstance()->getProgram() == getProgramID());
     }
 
+    /**
+     * Whether finishLink() can be called without waiting on the driver.
+     * Without KHR_parallel_shader_compile, or a GLEW that knows it, there's
+     * no asking, so this is always true and finishLink() does the waiting.
+     */
+    bool isLinkComplete() const;
+
     bool isProgramValid() {
       return programValid;
     }
 
-    void link();
+    /**
+     * Links the program, compiling its shaders first if need be.  With a
+     * cache file set, a binary saved by an earlier run is tried first, and
+     * the shaders aren't compiled at all if it loads.
+     */
+    void link() {
+      beginLink();
+      finishLink();
+    }
+
+    /**
+     * link() in two halves.  beginLink() sets the driver compiling and
+     * linking, and finishLink() checks how it went, throwing if it failed.
+     * In between, the driver can get on with it on threads of its own.
+     */
+    void beginLink();
+    void finishLink();
 
     void makeActive() {
       if (isProgramValid()) {
-        glUseProgram(programID);
+        GLState::getInstance()->useProgram(programID);
       }
     }
 
     void makeInactive() {
       if (isProgramValid() && isProgramActive()) {
-        glUseProgram(0);
+        GLState::getInstance()->useProgram(0);
       }
     }
 
@@ -121,6 +172,15 @@ namespace io {
       }
     }
 
+    /**
+     * Where link() keeps the linked program between runs.  The file is only
+     * used while the shader sources, attribute bindings and GL driver are
+     * the same as when it was saved.
+     */
+    void setCacheFilename(const std::string& filename) {
+      cacheFilename = filename;
+    }
+
     void setFragmentShader(FragmentShader* shader) {
       if (!isProgramValid()) {
         fragShader = shader;
@@ -135,14 +195,28 @@ namespace io {
 
     void unlink();
   private:
+    const static uint32_t PROGRAM_CACHE_VERSION = 1;
+
     std::map<unsigned int, std::string> bindings;
+    std::string cacheFilename;
+    uint32_t cacheKey;
     FragmentShader* fragShader;
+    bool linkPending;
+    std::chrono::steady_clock::time_point linkStart;
+    bool loadedFromCache;
     GLuint programID;
     bool programValid;
+    std::unordered_map<uint32_t, GLint> uniforms;
     VertexShader* vertShader;
 
     ShaderProgram(const ShaderProgram&);
     ShaderProgram& operator=(const ShaderProgram&);
+
+    uint32_t getCacheKey() const;
+    bool isCacheUsed() const;
+    bool loadBinary(const GLuint programID, const uint32_t key);
+    void reflectUniforms();
+    bool saveBinary(const uint32_t key) const;
   };
 }
 
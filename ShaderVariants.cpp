@@ -0,0 +1,202 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#include <cstdio>
+#include <exception>
+#include <stdexcept>
+#include "ShaderVariants.hpp"
+#include "Log.hpp"
+
+namespace io {
+  ShaderVariants::ShaderVariants(const std::string& filename, VertexShader* vertexShader, const std::vector<std::string>& attributes, const std::string& cacheStem)
+    : attributes(attributes), cacheStem(cacheStem), filename(filename), generic(nullptr), genericShader(nullptr),
+      variants(1 << ShaderFeatures::COUNT), vertShader(vertexShader) {
+    //  Older GLEWs don't know the extension, and build a variant a frame.
+#ifdef GL_KHR_parallel_shader_compile
+    parallel = GLEW_KHR_parallel_shader_compile;
+    if (parallel) {
+      //  Let the driver use as many threads as it likes.
+      glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    }
+#else
+    parallel = false;
+#endif
+
+    genericShader = new FragmentShader(filename, "#define GENERIC\n");
+    try {
+      generic = createProgram(genericShader, cacheStem + "-generic.program");
+      generic->link();
+    }
+    catch (std::exception& e) {
+      deleteProgram(generic);
+      delete genericShader;
+      throw;
+    }
+  }
+
+  ShaderVariants::~ShaderVariants() {
+    for (Variant& variant : variants) {
+      deleteProgram(variant.program);
+      delete variant.shader;
+    }
+
+    deleteProgram(generic);
+    delete genericShader;
+  }
+
+  ShaderProgram* ShaderVariants::createProgram(FragmentShader* fragmentShader, const std::string& cacheFilename) {
+    ShaderProgram* program = new ShaderProgram();
+
+    program->setFragmentShader(fragmentShader);
+    program->setVertexShader(vertShader);
+    program->setCacheFilename(cacheFilename);
+
+    for (unsigned int i = 0; i < attributes.size(); i++) {
+      program->addBinding(i, attributes[i]);
+    }
+
+    return program;
+  }
+
+  //  The shaders belong to someone else, so they're let go of first.
+  void ShaderVariants::deleteProgram(ShaderProgram* program) {
+    if (program) {
+      program->makeInactive();
+      program->unlink();
+      program->setFragmentShader(nullptr);
+      program->setVertexShader(nullptr);
+      delete program;
+    }
+  }
+
+  void ShaderVariants::finish(const uint32_t features) {
+    Variant& variant = variants[features];
+
+    try {
+      if (!parallel) {
+        variant.program->beginLink();
+      }
+      variant.program->finishLink();
+      variant.state = VariantState::READY;
+    }
+    catch (std::exception& e) {
+      writeToLog(MessageLevel::WARNING, "Could not build variant %u of \"%s\", the generic variant will be used instead:  %s\n", features, filename.c_str(), e.what());
+      deleteProgram(variant.program);
+      delete variant.shader;
+      variant.program = nullptr;
+      variant.shader = nullptr;
+      variant.state = VariantState::FAILED;
+    }
+  }
+
+  void ShaderVariants::getFeatureFlags(const uint32_t features, float flags[4]) {
+    flags[0] = (features & ShaderFeatures::TEXTURED) ? 1.0f : 0.0f;
+    flags[1] = (features & ShaderFeatures::VERTEX_COLOUR) ? 1.0f : 0.0f;
+    flags[2] = (features & ShaderFeatures::ALPHA_TEST) ? 1.0f : 0.0f;
+    flags[3] = (features & ShaderFeatures::DISTANCE_FIELD) ? 1.0f : 0.0f;
+  }
+
+  uint32_t ShaderVariants::getPendingCount() const {
+    uint32_t count = 0;
+    for (const Variant& variant : variants) {
+      if (variant.state == VariantState::PENDING) {
+        count++;
+      }
+    }
+
+    return count;
+  }
+
+  std::string ShaderVariants::getPreamble(const uint32_t features) {
+    std::string preamble;
+    if (features & ShaderFeatures::TEXTURED) {
+      preamble += "#define TEXTURED\n";
+    }
+    if (features & ShaderFeatures::VERTEX_COLOUR) {
+      preamble += "#define VERTEX_COLOUR\n";
+    }
+    if (features & ShaderFeatures::ALPHA_TEST) {
+      preamble += "#define ALPHA_TEST\n";
+    }
+    if (features & ShaderFeatures::DISTANCE_FIELD) {
+      preamble += "#define DISTANCE_FIELD\n";
+    }
+
+    return preamble;
+  }
+
+  ShaderProgram* ShaderVariants::getProgram(const uint32_t features) {
+    if (features >= variants.size()) {
+      return generic;
+    }
+
+    Variant& variant = variants[features];
+    if (variant.state == VariantState::READY) {
+      return variant.program;
+    }
+
+    if (variant.state == VariantState::UNUSED) {
+      try {
+        char cacheFilename[256];
+        snprintf(cacheFilename, sizeof(cacheFilename), "%s-%02x.program", cacheStem.c_str(), features);
+
+        variant.shader = new FragmentShader(filename, getPreamble(features));
+        variant.program = createProgram(variant.shader, cacheFilename);
+        variant.state = VariantState::PENDING;
+
+        //  Without parallel compiles, the work is left for update().
+        if (parallel) {
+          variant.program->beginLink();
+        }
+      }
+      catch (std::exception& e) {
+        writeToLog(MessageLevel::WARNING, "Could not start variant %u of \"%s\", the generic variant will be used instead:  %s\n", features, filename.c_str(), e.what());
+        deleteProgram(variant.program);
+        delete variant.shader;
+        variant.program = nullptr;
+        variant.shader = nullptr;
+        variant.state = VariantState::FAILED;
+      }
+    }
+
+    return generic;
+  }
+
+  uint32_t ShaderVariants::update() {
+    uint32_t ready = 0;
+
+    for (uint32_t features = 0; features < variants.size(); features++) {
+      Variant& variant = variants[features];
+      if (variant.state != VariantState::PENDING) {
+        continue;
+      }
+
+      if (parallel && !variant.program->isLinkComplete()) {
+        continue;
+      }
+
+      finish(features);
+      if (variant.state == VariantState::READY) {
+        ready++;
+      }
+
+      if (!parallel) {
+        break;
+      }
+    }
+
+    return ready;
+  }
+}
@@ -0,0 +1,119 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#ifndef ShaderVariantsHPP
+#define ShaderVariantsHPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Common.hpp"
+#include "FragmentShader.hpp"
+#include "ShaderProgram.hpp"
+#include "VertexShader.hpp"
+
+namespace io {
+  /**
+   * What a variant of a fragment shader does.  Each is a #define at the top
+   * of its source, so a variant only pays for the features it uses.
+   */
+  struct ShaderFeatures {
+    const static uint32_t TEXTURED = 1 << 0;
+    const static uint32_t VERTEX_COLOUR = 1 << 1;
+    const static uint32_t ALPHA_TEST = 1 << 2;
+    const static uint32_t DISTANCE_FIELD = 1 << 3;
+
+    const static uint32_t COUNT = 4;
+  };
+
+  /**
+   * Programs built from one fragment shader source with different features
+   * defined.  Variants are built when they're first asked for, and until
+   * one is ready, the generic variant stands in for it.  The generic
+   * variant has every feature, switched on and off by the inFeatures
+   * uniform, and is built up front.
+   *
+   * With KHR_parallel_shader_compile, variants are built on the driver's
+   * own threads, and update() picks them up once they're done.  Without
+   * it, update() builds one variant at a time, so that no frame stalls on
+   * more than one.
+   */
+  class ShaderVariants {
+  public:
+    /**
+     * attributes are bound to the locations they sit at.  Each variant is
+     * kept in the program cache, in a file named after cacheStem.  Throws
+     * if the generic variant can't be built.
+     */
+    ShaderVariants(const std::string& filename, VertexShader* vertexShader, const std::vector<std::string>& attributes, const std::string& cacheStem);
+    ~ShaderVariants();
+
+    ShaderProgram* getGeneric() {
+      return generic;
+    }
+
+    uint32_t getPendingCount() const;
+
+    /**
+     * The variant with features, if it's been built.  If it hasn't, it's
+     * started, and the generic variant is returned in its place.
+     */
+    ShaderProgram* getProgram(const uint32_t features);
+
+    //  inFeatures holds this for the generic variant.
+    static void getFeatureFlags(const uint32_t features, float flags[4]);
+
+    /**
+     * Finishes whichever variants the driver is done with.  Returns the
+     * number that became ready.
+     */
+    uint32_t update();
+  private:
+    enum class VariantState : uint8_t {
+      UNUSED,
+      PENDING,
+      READY,
+      FAILED
+    };
+
+    struct Variant {
+      Variant() : program(nullptr), shader(nullptr), state(VariantState::UNUSED) {
+      }
+
+      ShaderProgram* program;
+      FragmentShader* shader;
+      VariantState state;
+    };
+
+    std::vector<std::string> attributes;
+    std::string cacheStem;
+    std::string filename;
+    ShaderProgram* generic;
+    FragmentShader* genericShader;
+    bool parallel;
+    std::vector<Variant> variants;
+    VertexShader* vertShader;
+
+    ShaderVariants(const ShaderVariants&);
+    ShaderVariants& operator=(const ShaderVariants&);
+
+    ShaderProgram* createProgram(FragmentShader* fragmentShader, const std::string& cacheFilename);
+    static void deleteProgram(ShaderProgram* program);
+    void finish(const uint32_t features);
+    static std::string getPreamble(const uint32_t features);
+  };
+}
+
+#endif // ShaderVariantsHPP
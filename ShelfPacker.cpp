@@ -0,0 +1,59 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#include "ShelfPacker.hpp"
+
+namespace io {
+  bool ShelfPacker::pack(const uint32_t w, const uint32_t h, uint32_t& x, uint32_t& y) {
+    if (w > width || h > height) {
+      return false;
+    }
+
+    Shelf* best = nullptr;
+    for (Shelf& shelf : shelves) {
+      if (shelf.height >= h && width - shelf.used >= w) {
+        if (!best || shelf.height < best->height) {
+          best = &shelf;
+        }
+      }
+    }
+
+    //  Don't waste a tall shelf on something much shorter if there's still
+    //  room to open one that fits it better.
+    if (best && best->height > h + (h / 2) && height - nextShelfY >= h) {
+      best = nullptr;
+    }
+
+    if (!best) {
+      if (height - nextShelfY < h) {
+        return false;
+      }
+
+      Shelf shelf;
+      shelf.y = nextShelfY;
+      shelf.height = h;
+      shelf.used = 0;
+      shelves.push_back(shelf);
+      nextShelfY += h;
+      best = &shelves.back();
+    }
+
+    x = best->used;
+    y = best->y;
+    best->used += w;
+
+    return true;
+  }
+}
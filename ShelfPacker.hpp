@@ -0,0 +1,72 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#ifndef ShelfPackerHPP
+#define ShelfPackerHPP
+
+#include <cstdint>
+#include <vector>
+
+namespace io {
+  /**
+   * Packs rectangles into a fixed size area as rows of shelves.  Each
+   * rectangle goes on the shortest shelf it fits on, and a new shelf is
+   * opened below the others when none will take it.  Rectangles are never
+   * removed, short of clearing the whole thing.
+   */
+  class ShelfPacker {
+  public:
+    ShelfPacker(const uint32_t width, const uint32_t height)
+      : width(width), height(height), nextShelfY(0) {
+    }
+
+    void clear() {
+      shelves.clear();
+      nextShelfY = 0;
+    }
+
+    uint32_t getHeight() const {
+      return height;
+    }
+
+    //  How much of the area is taken up by shelves, from 0 to 1.
+    float getUsage() const {
+      return (float)nextShelfY / height;
+    }
+
+    uint32_t getWidth() const {
+      return width;
+    }
+
+    /**
+     * Finds room for a w x h rectangle.  Returns false if there isn't any,
+     * otherwise the top left corner goes in x and y.
+     */
+    bool pack(const uint32_t w, const uint32_t h, uint32_t& x, uint32_t& y);
+  private:
+    struct Shelf {
+      uint32_t y;
+      uint32_t height;
+      uint32_t used;
+    };
+
+    uint32_t width;
+    uint32_t height;
+    uint32_t nextShelfY;
+    std::vector<Shelf> shelves;
+  };
+}
+
+#endif // ShelfPackerHPP
@@ -0,0 +1,153 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#include "SpriteBatch.hpp"
+#include "GLState.hpp"
+#include "Mesh.hpp"
+
+namespace io {
+  SpriteBatch::~SpriteBatch() {
+    if (bufferID != 0) {
+      GLState::getInstance()->deleteBuffer(bufferID);
+    }
+  }
+
+  /**
+   * Colours are premultiplied here, so the shader only has to scale them by
+   * what it reads from the texture.
+   */
+  static Colour premultiply(const Colour& colour) {
+    uint32_t a = colour.getA();
+    return Colour((colour.getR() * a) / 255, (colour.getG() * a) / 255, (colour.getB() * a) / 255, a);
+  }
+
+  void SpriteBatch::addMesh(const Mesh* mesh, const Matrix& transform, const GLuint texture, const SampleMode sampleMode, const Colour& colour) {
+    if (!mesh || mesh->getMeshType() != GL_TRIANGLES || mesh->getVertexCount() == 0) {
+      return;
+    }
+
+    Colour tint = premultiply(colour);
+    for (const Vertex& source : mesh->getVertices()) {
+      Vertex v;
+      v.position = source.position * transform;
+      v.texCoord = source.texCoord;
+      v.colour = tint;
+      vertices.push_back(v);
+    }
+
+    extend(texture, sampleMode, mesh->getVertexCount());
+  }
+
+  void SpriteBatch::addQuad(const Matrix& transform, const float x, const float y, const float w, const float h,
+                            const float u0, const float v0, const float u1, const float v1,
+                            const GLuint texture, const SampleMode sampleMode, const Colour& colour) {
+    const float corners[6][2] = {
+      { 0.0f, 0.0f }, { 0.0f, 1.0f }, { 1.0f, 1.0f },
+      { 1.0f, 1.0f }, { 1.0f, 0.0f }, { 0.0f, 0.0f }
+    };
+
+    Colour tint = premultiply(colour);
+    for (const float* corner : corners) {
+      Vertex v;
+      v.position = Vector3(x + (corner[0] * w), y + (corner[1] * h), 0.0f) * transform;
+      v.texCoord = Vector2(u0 + (corner[0] * (u1 - u0)), v0 + (corner[1] * (v1 - v0)));
+      v.colour = tint;
+      vertices.push_back(v);
+    }
+
+    extend(texture, sampleMode, 6);
+  }
+
+  void SpriteBatch::clear() {
+    vertices.clear();
+    ranges.clear();
+    sealedRanges = 0;
+    uploadedRanges = 0;
+    uploadedVertices = 0;
+  }
+
+  void SpriteBatch::draw(const uint32_t range) {
+    if (uploadedVertices < vertices.size()) {
+      upload();
+    }
+
+    //  Unlike Mesh, the colours are normalized, so the shader can tint with
+    //  them.
+    const Range& r = ranges[range];
+    GLState* state = GLState::getInstance();
+    state->bindArrayBuffer(r.buffer);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)(uintptr_t)r.offset);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (GLvoid*)(uintptr_t)(r.offset + sizeof(Vector3)));
+    glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (GLvoid*)(uintptr_t)(r.offset + sizeof(Vector3) + sizeof(Vector2)));
+
+    glDrawArrays(GL_TRIANGLES, 0, r.count);
+    state->recordDraw(r.count);
+  }
+
+  void SpriteBatch::extend(const GLuint texture, const SampleMode sampleMode, const uint32_t count) {
+    //  Ranges that have been written out can't grow either, since what
+    //  follows them in the stream belongs to someone else.
+    if (ranges.size() > sealedRanges && ranges.size() > uploadedRanges) {
+      Range& last = ranges.back();
+      if (last.texture == texture && last.sampleMode == sampleMode) {
+        last.count += count;
+        return;
+      }
+    }
+
+    Range range;
+    range.texture = texture;
+    range.sampleMode = sampleMode;
+    range.first = vertices.size() - count;
+    range.count = count;
+    range.buffer = 0;
+    range.offset = 0;
+    ranges.push_back(range);
+  }
+
+  void SpriteBatch::upload() {
+    uint32_t size = (vertices.size() - uploadedVertices) * sizeof(Vertex);
+    uint32_t offset = 0;
+    if (stream && stream->write(&vertices[uploadedVertices], size, offset)) {
+      for (uint32_t i = uploadedRanges; i < ranges.size(); i++) {
+        ranges[i].buffer = stream->getBufferID();
+        ranges[i].offset = offset + ((ranges[i].first - uploadedVertices) * sizeof(Vertex));
+      }
+    }
+    else {
+      //  The stream is full for this frame, so the whole frame goes into a
+      //  buffer of the batch's own.  Orphaning it means not waiting on any
+      //  draws still reading the old contents.
+      if (bufferID == 0) {
+        glGenBuffers(1, &bufferID);
+      }
+
+      GLsizeiptr total = vertices.size() * sizeof(Vertex);
+      GLState* state = GLState::getInstance();
+      state->bindArrayBuffer(bufferID);
+      glBufferData(GL_ARRAY_BUFFER, total, nullptr, GL_STREAM_DRAW);
+      glBufferSubData(GL_ARRAY_BUFFER, 0, total, vertices.data());
+      state->recordBufferUpload(total);
+
+      for (Range& range : ranges) {
+        range.buffer = bufferID;
+        range.offset = range.first * sizeof(Vertex);
+      }
+    }
+
+    uploadedRanges = ranges.size();
+    uploadedVertices = vertices.size();
+  }
+}
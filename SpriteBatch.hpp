@@ -0,0 +1,120 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#ifndef SpriteBatchHPP
+#define SpriteBatchHPP
+
+#include <cstdint>
+#include <vector>
+#include "Colour.hpp"
+#include "Common.hpp"
+#include "Matrix.hpp"
+#include "StreamBuffer.hpp"
+#include "Vertex.hpp"
+
+namespace io {
+  class Mesh;
+
+  /**
+   * How the batch shader turns a texel into colour.  All of them come out
+   * premultiplied by alpha, and tinted by the vertex colour.
+   */
+  enum class SampleMode : uint8_t {
+    //  An RGBA image with straight alpha.
+    IMAGE,
+    //  A single channel of coverage, as bitmap glyphs are stored.
+    COVERAGE,
+    //  A signed distance field, as distance field glyphs are stored.
+    DISTANCE_FIELD,
+    //  An RGBA image with premultiplied alpha, as render targets hold.
+    PREMULTIPLIED_IMAGE
+  };
+
+  /**
+   * Collects 2D triangles for a frame.  Triangles are moved into place as
+   * they're added, and runs of them that share a texture and sample mode
+   * become one range, drawn with one call.  Ranges keep the order they were
+   * added in, so overlapping UI still draws correctly.
+   *
+   * Vertices are written to the stream buffer the first time any of them
+   * are drawn, and only those added since are written the next time.
+   */
+  class SpriteBatch {
+  public:
+    struct Range {
+      GLuint texture;
+      SampleMode sampleMode;
+      uint32_t first;
+      uint32_t count;
+
+      //  Where the range's vertices were written, once they have been.
+      GLuint buffer;
+      uint32_t offset;
+    };
+
+    SpriteBatch(StreamBuffer* stream)
+      : stream(stream), bufferID(0), sealedRanges(0), uploadedRanges(0), uploadedVertices(0) {
+    }
+
+    ~SpriteBatch();
+
+    //  Adds the triangles of a mesh, moved by transform.
+    void addMesh(const Mesh* mesh, const Matrix& transform, const GLuint texture, const SampleMode sampleMode, const Colour& colour);
+
+    //  Adds a rectangle showing (u0, v0) to (u1, v1) of the texture.
+    void addQuad(const Matrix& transform, const float x, const float y, const float w, const float h,
+                 const float u0, const float v0, const float u1, const float v1,
+                 const GLuint texture, const SampleMode sampleMode, const Colour& colour);
+
+    //  Throws everything away, ready for the next frame.
+    void clear();
+
+    //  Draws one range, writing out any new vertices first.
+    void draw(const uint32_t range);
+
+    const Range& getRange(const uint32_t range) const {
+      return ranges[range];
+    }
+
+    uint32_t getRangeCount() const {
+      return ranges.size();
+    }
+
+    //  Ranges before this have been handed out, and can't grow any more.
+    uint32_t getSealedRangeCount() const {
+      return sealedRanges;
+    }
+
+    void seal() {
+      sealedRanges = ranges.size();
+    }
+  private:
+    StreamBuffer* stream;
+    GLuint bufferID;
+    uint32_t sealedRanges;
+    uint32_t uploadedRanges;
+    uint32_t uploadedVertices;
+    std::vector<Vertex> vertices;
+    std::vector<Range> ranges;
+
+    SpriteBatch(const SpriteBatch&);
+    SpriteBatch& operator=(const SpriteBatch&);
+
+    void extend(const GLuint texture, const SampleMode sampleMode, const uint32_t count);
+    void upload();
+  };
+}
+
+#endif // SpriteBatchHPP
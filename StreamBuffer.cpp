@@ -0,0 +1,123 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#include "StreamBuffer.hpp"
+#include <cstring>
+#include "GLState.hpp"
+#include "Log.hpp"
+
+namespace io {
+  StreamBuffer::StreamBuffer(const uint32_t sectionSize)
+    : bufferID(0), sectionSize(sectionSize), section(0), used(0), demand(0) {
+    for (GLsync& fence : fences) {
+      fence = 0;
+    }
+
+    //  Unsynchronized writes are only safe with fences to wait on.
+    mapped = (GLEW_ARB_map_buffer_range && GLEW_ARB_sync);
+    if (!mapped) {
+      writeToLog(MessageLevel::INFO, "Buffer mapping or sync objects not supported, streamed vertices will be uploaded.\n");
+    }
+
+    glGenBuffers(1, &bufferID);
+    allocate();
+  }
+
+  StreamBuffer::~StreamBuffer() {
+    for (GLsync fence : fences) {
+      if (fence) {
+        glDeleteSync(fence);
+      }
+    }
+
+    GLState::getInstance()->deleteBuffer(bufferID);
+  }
+
+  //  Every section is thrown away along with the old storage, so nothing
+  //  is left to wait for.
+  void StreamBuffer::allocate() {
+    for (GLsync& fence : fences) {
+      if (fence) {
+        glDeleteSync(fence);
+        fence = 0;
+      }
+    }
+
+    GLState::getInstance()->bindArrayBuffer(bufferID);
+    glBufferData(GL_ARRAY_BUFFER, sectionSize * StreamBuffer::SECTION_COUNT, nullptr, GL_STREAM_DRAW);
+    section = 0;
+    used = 0;
+  }
+
+  void StreamBuffer::endFrame() {
+    if (demand > sectionSize) {
+      while (sectionSize < demand) {
+        sectionSize *= 2;
+      }
+
+      writeToLog(MessageLevel::INFO, "Stream buffer sections grown to %u bytes.\n", sectionSize);
+      allocate();
+      demand = 0;
+      return;
+    }
+
+    if (mapped) {
+      fences[section] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    section = (section + 1) % StreamBuffer::SECTION_COUNT;
+    used = 0;
+    demand = 0;
+
+    //  With three sections this hardly ever has to wait at all.
+    if (fences[section]) {
+      glClientWaitSync(fences[section], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+      glDeleteSync(fences[section]);
+      fences[section] = 0;
+    }
+  }
+
+  bool StreamBuffer::write(const void* data, const uint32_t size, uint32_t& offset) {
+    //  Writes that don't fit still count towards what the section needs.
+    uint32_t mask = StreamBuffer::ALIGNMENT - 1;
+    demand = ((demand + mask) & ~mask) + size;
+
+    uint32_t start = (used + mask) & ~mask;
+    if (start + size > sectionSize) {
+      return false;
+    }
+
+    offset = (section * sectionSize) + start;
+    used = start + size;
+
+    GLState* state = GLState::getInstance();
+    state->bindArrayBuffer(bufferID);
+    void* destination = nullptr;
+    if (mapped) {
+      destination = glMapBufferRange(GL_ARRAY_BUFFER, offset, size, GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT);
+    }
+
+    if (destination) {
+      ::memcpy(destination, data, size);
+      glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+    else {
+      glBufferSubData(GL_ARRAY_BUFFER, offset, size, data);
+    }
+
+    state->recordBufferUpload(size);
+    return true;
+  }
+}
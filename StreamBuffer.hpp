@@ -0,0 +1,85 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#ifndef StreamBufferHPP
+#define StreamBufferHPP
+
+#include <cstdint>
+#include "Common.hpp"
+
+namespace io {
+  /**
+   * One big vertex buffer for data that only lives for a frame, split into
+   * a section per frame in flight.  Writes go one after another into the
+   * current frame's section, and are copied straight into the buffer
+   * through an unsynchronized mapping.  A fence at the end of each frame
+   * makes sure the GPU is done with a section before it's written again.
+   *
+   * Without map_buffer_range and sync, writes go through glBufferSubData
+   * instead, and the driver does the waiting.
+   */
+  class StreamBuffer {
+  public:
+    const static uint32_t SECTION_COUNT = 3;
+
+    //  sectionSize bytes are available to each frame.
+    StreamBuffer(const uint32_t sectionSize);
+    ~StreamBuffer();
+
+    /**
+     * Moves on to the next frame's section, first waiting for the GPU to
+     * finish with it if need be.  Call once all of this frame's draws have
+     * been made.
+     */
+    void endFrame();
+
+    GLuint getBufferID() const {
+      return bufferID;
+    }
+
+    uint32_t getSectionSize() const {
+      return sectionSize;
+    }
+
+    /**
+     * Copies size bytes into this frame's section, and puts where they went
+     * in offset.  Returns false if the section is full, in which case the
+     * caller has to find somewhere else for them.  The sections grow to fit
+     * at the next endFrame().  The buffer is left bound.
+     */
+    bool write(const void* data, const uint32_t size, uint32_t& offset);
+  private:
+    //  Keeps every write on a boundary that any attribute can start on.
+    const static uint32_t ALIGNMENT = 16;
+
+    GLuint bufferID;
+    uint32_t sectionSize;
+    uint32_t section;
+
+    //  Bytes written to the current section, and the bytes that would have
+    //  been if it had been big enough.
+    uint32_t used;
+    uint32_t demand;
+    GLsync fences[StreamBuffer::SECTION_COUNT];
+    bool mapped;
+
+    StreamBuffer(const StreamBuffer&);
+    StreamBuffer& operator=(const StreamBuffer&);
+
+    void allocate();
+  };
+}
+
+#endif // StreamBufferHPP
@@ -0,0 +1,166 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#include "TextLayout.hpp"
+#include "Font.hpp"
+#include "Graphics.hpp"
+#include "Utility.hpp"
+#include <algorithm>
+
+namespace io {
+  void TextLayout::append(const std::string& more) {
+    std::size_t from = text.size();
+    text += more;
+
+    if (isLaidOut()) {
+      layOut(from);
+    }
+  }
+
+  void TextLayout::draw(Graphics* g, const Colour& colour) {
+    validate();
+    if (!font) {
+      return;
+    }
+
+    if (lines.size() == 1) {
+      font->drawText(g, lines[0].text, colour);
+      return;
+    }
+
+    g->pushMatrix();
+    for (const Line& line : lines) {
+      font->drawText(g, line.text, colour);
+      g->translate(0.0f, font->getPixelSize(), 0.0f);
+    }
+    g->popMatrix();
+  }
+
+  BoundingBox TextLayout::getBoundingBox() {
+    validate();
+    if (!font) {
+      return BoundingBox(0, 0, 0, 0);
+    }
+
+    float w = 0.0f;
+    for (const Line& line : lines) {
+      w = std::max(w, line.width);
+    }
+
+    return BoundingBox(0, 0, w, (float)lines.size() * font->getPixelSize());
+  }
+
+  bool TextLayout::isLaidOut() const {
+    return (font && font == laidOutFont && font->getPixelSize() == laidOutPixelSize);
+  }
+
+  /**
+   * Lays out the text from byte from onwards, carrying on from the code
+   * points before it.  from has to be at the start of a code point.
+   */
+  void TextLayout::layOut(const std::size_t from) {
+    if (lines.empty()) {
+      Line first;
+      first.start = 0;
+      first.width = 0.0f;
+      lines.push_back(first);
+    }
+
+    uint32_t previous = (codePoints.empty() || codePoints.back() == '\n') ? 0 : codePoints.back();
+    std::size_t index = from;
+    while (index < text.size()) {
+      std::size_t start = index;
+      uint32_t c = decodeUTF8(text, index);
+
+      if (c == '\n') {
+        Line line;
+        line.start = index;
+        line.width = 0.0f;
+        lines.push_back(line);
+        previous = 0;
+      }
+      else {
+        Line& line = lines.back();
+        line.width += font->getAdvance(previous, c);
+        line.text.append(text, start, index - start);
+        previous = c;
+      }
+
+      starts.push_back(start);
+      codePoints.push_back(c);
+      positions.push_back(lines.back().width);
+    }
+  }
+
+  void TextLayout::setText(const std::string& text) {
+    if (text == this->text) {
+      return;
+    }
+
+    this->text = text;
+    laidOutFont = nullptr;
+  }
+
+  void TextLayout::truncate(const std::size_t length) {
+    if (length >= text.size()) {
+      return;
+    }
+
+    text.resize(length);
+    if (!isLaidOut()) {
+      return;
+    }
+
+    //  Drop every code point that starts past the cut, and the one before
+    //  them too, in case the cut went through the middle of it.  Whatever
+    //  is left of that one gets laid out again.
+    std::size_t from = 0;
+    bool dropped = false;
+    while (!starts.empty() && (starts.back() >= length || !dropped)) {
+      dropped = (starts.back() < length);
+      from = starts.back();
+      if (codePoints.back() == '\n') {
+        lines.pop_back();
+      }
+
+      starts.pop_back();
+      codePoints.pop_back();
+      positions.pop_back();
+    }
+
+    Line& line = lines.back();
+    line.text.resize(from - line.start);
+    line.width = (codePoints.empty() || codePoints.back() == '\n') ? 0.0f : positions.back();
+
+    layOut(from);
+  }
+
+  void TextLayout::validate() {
+    if (isLaidOut()) {
+      return;
+    }
+
+    lines.clear();
+    starts.clear();
+    codePoints.clear();
+    positions.clear();
+
+    laidOutFont = font;
+    laidOutPixelSize = font ? font->getPixelSize() : 0;
+    if (font) {
+      layOut(0);
+    }
+  }
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#ifndef TextLayoutHPP
+#define TextLayoutHPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "BoundingBox.hpp"
+#include "Colour.hpp"
+
+namespace io {
+  class Font;
+  class Graphics;
+
+  /**
+   * A string laid out with a font, kept until the text, the font or the
+   * font's size changes.  Lines are broken at '\n'.  Text added to or cut
+   * from the end with append() and truncate() only lays out the part that
+   * changed, which suits text being typed.
+   */
+  class TextLayout {
+  public:
+    TextLayout() : font(nullptr), laidOutFont(nullptr), laidOutPixelSize(0) {
+    }
+
+    void append(const std::string& more);
+    void draw(Graphics* g, const Colour& colour);
+
+    //  The width of the widest line, and the height of all of them.
+    BoundingBox getBoundingBox();
+
+    Font* getFont() const {
+      return font;
+    }
+
+    uint32_t getLineCount() {
+      validate();
+      return lines.size();
+    }
+
+    /**
+     * Where the pen is after each code point, from the start of its line.
+     * This is where a caret after it would go.
+     */
+    const std::vector<float>& getPositions() {
+      validate();
+      return positions;
+    }
+
+    const std::string& getText() const {
+      return text;
+    }
+
+    void setFont(Font* font) {
+      this->font = font;
+    }
+
+    void setText(const std::string& text);
+
+    //  Cuts the text down to length bytes.
+    void truncate(const std::size_t length);
+  private:
+    struct Line {
+      std::size_t start;
+      std::string text;
+      float width;
+    };
+
+    Font* font;
+    Font* laidOutFont;
+    uint32_t laidOutPixelSize;
+
+    std::string text;
+    std::vector<Line> lines;
+
+    //  One of each of these per code point.
+    std::vector<std::size_t> starts;
+    std::vector<uint32_t> codePoints;
+    std::vector<float> positions;
+
+    bool isLaidOut() const;
+    void layOut(const std::size_t from);
+    void validate();
+  };
+}
+
+#endif // TextLayoutHPP
@@ -15,7 +15,9 @@
 */
 #include <stdexcept>
 #include <cstdio>
+#include <vector>
 #include "Texture.hpp"
+#include "GLState.hpp"
 
 namespace io {
   //FIXME:  This needs serious re-working.  It works for now, though.
@@ -24,8 +26,9 @@ namespace io {
       throw std::invalid_argument("Texture::Texture");
     }
     
+    format = TextureFormat::RGBA;
     glGenTextures(1, &texID);
-    glBindTexture(GL_TEXTURE_2D, texID);
+    GLState::getInstance()->bindTexture(texID);
     
     data = new uint8_t[image->getWidth() * image->getHeight() * 4];
     for (uint32_t y = 0; y < image->getHeight(); y++) {
@@ -51,15 +54,68 @@ namespace io {
   }
     
 
+  Texture::Texture(const uint32_t width, const uint32_t height, const TextureFormat format) {
+    this->data = nullptr;
+    this->format = format;
+    this->width = width;
+    this->height = height;
+
+    glGenTextures(1, &texID);
+    GLState::getInstance()->bindTexture(texID);
+
+    //  Single channel rows aren't necessarily a multiple of four bytes.
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    GLenum pixelFormat = getPixelFormat(format);
+    GLenum internalFormat = (format == TextureFormat::LUMINANCE) ? GL_LUMINANCE8 : GL_RGBA8;
+    std::vector<uint8_t> empty(width * height * ((format == TextureFormat::LUMINANCE) ? 1 : 4), 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, pixelFormat, GL_UNSIGNED_BYTE, empty.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+  }
+
   Texture::~Texture() {
+    GLState::getInstance()->deleteTexture(texID);
+
     if (data) {
-      glDeleteTextures(1, &texID);
       delete [] data;
     }
   }
 
+  GLenum Texture::getPixelFormat(const TextureFormat format) {
+    switch (format) {
+    case TextureFormat::LUMINANCE:
+      return GL_LUMINANCE;
+    default:
+      break;
+    }
+
+    return GL_RGBA;
+  }
+
   void Texture::makeActive() {
-    glBindTexture(GL_TEXTURE_2D, texID);
+    GLState::getInstance()->bindTexture(texID);
+  }
+
+  //  Linear filtering when smooth, otherwise nearest, both ways.
+  void Texture::setSmooth(const bool smooth) {
+    GLenum filter = smooth ? GL_LINEAR : GL_NEAREST;
+    GLState::getInstance()->bindTexture(texID);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+  }
+
+  void Texture::update(const uint32_t x, const uint32_t y, const uint32_t w, const uint32_t h, const uint8_t* pixels) {
+    if (w == 0 || h == 0) {
+      return;
+    }
+
+    GLState::getInstance()->bindTexture(texID);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, w, h, getPixelFormat(format), GL_UNSIGNED_BYTE, pixels);
+    GLState::getInstance()->recordBufferUpload(w * h * ((format == TextureFormat::LUMINANCE) ? 1 : 4));
   }
   /*
       glGenTextures(1, &(newTex->texID));
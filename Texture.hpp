@@ -22,11 +22,25 @@
 #include "Image.hpp"
 
 namespace io {
+  enum class TextureFormat : uint8_t {
+    RGBA,
+    //  One channel, which is read back as grey with full alpha.  GL 2.1's
+    //  stand in for R8.
+    LUMINANCE
+  };
+
   class Texture {
   public:
     Texture(Image* inImage);
+
+    //  An empty texture, to be filled in with update().
+    Texture(const uint32_t width, const uint32_t height, const TextureFormat format);
     ~Texture();
 
+    GLuint getTextureID() const {
+      return texID;
+    }
+
     uint32_t getHeight() const {
       return height;
     }
@@ -36,11 +50,21 @@ namespace io {
     }
 
     void makeActive();
+    void setSmooth(const bool smooth);
+
+    //  Replaces part of the texture.  pixels is tightly packed.
+    void update(const uint32_t x, const uint32_t y, const uint32_t w, const uint32_t h, const uint8_t* pixels);
   private:
     uint8_t* data;
+    TextureFormat format;
     uint32_t height;
     GLuint texID;
     uint32_t width;
+
+    Texture(const Texture&);
+    Texture& operator=(const Texture&);
+
+    static GLenum getPixelFormat(const TextureFormat format);
   };
 }
 
@@ -0,0 +1,108 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#include "TextureAtlas.hpp"
+#include <algorithm>
+#include "Image.hpp"
+#include "Log.hpp"
+#include "ResourceManager.hpp"
+
+namespace io {
+  TextureAtlas::~TextureAtlas() {
+    for (Texture* page : pages) {
+      delete page;
+    }
+    pages.clear();
+  }
+
+  const AtlasRegion* TextureAtlas::add(const std::string& filename) {
+    const AtlasRegion* region = getRegion(filename);
+    if (region) {
+      return region;
+    }
+
+    Resource* resource = ResourceManager::getInstance()->getResource(filename);
+    Image* image = resource ? resource->toImage() : nullptr;
+    if (!image) {
+      writeToLog(MessageLevel::WARNING, "Could not add \"%s\" to a texture atlas.\n", filename.c_str());
+      return nullptr;
+    }
+
+    return add(filename, image);
+  }
+
+  const AtlasRegion* TextureAtlas::add(const std::string& name, Image* image) {
+    const AtlasRegion* existing = getRegion(name);
+    if (existing) {
+      return existing;
+    }
+
+    uint32_t w = image->getWidth();
+    uint32_t h = image->getHeight();
+    if (w == 0 || h == 0) {
+      writeToLog(MessageLevel::WARNING, "\"%s\" is empty, so can't go in a texture atlas.\n", name.c_str());
+      return nullptr;
+    }
+
+    uint32_t borderedW = w + (TextureAtlas::BORDER * 2);
+    uint32_t borderedH = h + (TextureAtlas::BORDER * 2);
+    uint32_t page = 0;
+    uint32_t x = 0;
+    uint32_t y = 0;
+    if (!packer.pack(borderedW, borderedH, page, x, y)) {
+      writeToLog(MessageLevel::WARNING, "\"%s\" is too big for a texture atlas page.\n", name.c_str());
+      return nullptr;
+    }
+
+    if (page == pages.size()) {
+      pages.push_back(new Texture(TextureAtlas::PAGE_SIZE, TextureAtlas::PAGE_SIZE, TextureFormat::RGBA));
+      writeToLog(MessageLevel::INFO, "Added texture atlas page %u (%u bytes in use).\n", page + 1, getMemoryUsed());
+    }
+
+    //  Clamping the coordinates repeats the edges out into the border.
+    std::vector<uint8_t> pixels(borderedW * borderedH * 4);
+    for (uint32_t row = 0; row < borderedH; row++) {
+      uint32_t sourceY = std::min(std::max(row, TextureAtlas::BORDER) - TextureAtlas::BORDER, h - 1);
+      for (uint32_t column = 0; column < borderedW; column++) {
+        uint32_t sourceX = std::min(std::max(column, TextureAtlas::BORDER) - TextureAtlas::BORDER, w - 1);
+        uint8_t* pixel = &pixels[((row * borderedW) + column) * 4];
+        image->getPixel(sourceX, sourceY, pixel[0], pixel[1], pixel[2], pixel[3]);
+      }
+    }
+    pages[page]->update(x, y, borderedW, borderedH, pixels.data());
+
+    AtlasRegion region;
+    region.texture = pages[page];
+    region.x = x + TextureAtlas::BORDER;
+    region.y = y + TextureAtlas::BORDER;
+    region.w = w;
+    region.h = h;
+    region.u0 = (float)region.x / TextureAtlas::PAGE_SIZE;
+    region.v0 = (float)region.y / TextureAtlas::PAGE_SIZE;
+    region.u1 = (float)(region.x + w) / TextureAtlas::PAGE_SIZE;
+    region.v1 = (float)(region.y + h) / TextureAtlas::PAGE_SIZE;
+
+    return &(regions[name] = region);
+  }
+
+  const AtlasRegion* TextureAtlas::getRegion(const std::string& name) const {
+    std::map<std::string, AtlasRegion>::const_iterator iter = regions.find(name);
+    if (iter != regions.end()) {
+      return &iter->second;
+    }
+
+    return nullptr;
+  }
+}
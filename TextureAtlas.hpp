@@ -0,0 +1,101 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#ifndef TextureAtlasHPP
+#define TextureAtlasHPP
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+#include "PagedShelfPacker.hpp"
+#include "Texture.hpp"
+
+namespace io {
+  class Image;
+
+  /**
+   * Where an image ended up in a TextureAtlas.  x, y, w and h are in
+   * pixels, and the texture coordinates cover exactly the image.
+   */
+  struct AtlasRegion {
+    Texture* texture;
+    uint32_t x;
+    uint32_t y;
+    uint32_t w;
+    uint32_t h;
+    float u0;
+    float v0;
+    float u1;
+    float v1;
+  };
+
+  /**
+   * RGBA pages that separately loaded images are packed into, so that
+   * things drawn with any of them can share a texture, and so a batch.
+   * Images are packed on shelves, and a new page is added when the others
+   * are full.
+   */
+  class TextureAtlas {
+  public:
+    const static uint32_t PAGE_SIZE = 512;
+
+    TextureAtlas() : packer(TextureAtlas::PAGE_SIZE, TextureAtlas::PAGE_SIZE) {
+    }
+
+    ~TextureAtlas();
+
+    /**
+     * Loads an image through the ResourceManager and packs it.  Adding the
+     * same file twice gives back the same region.  Returns nullptr if the
+     * image can't be loaded, is empty or is bigger than a page.
+     */
+    const AtlasRegion* add(const std::string& filename);
+    const AtlasRegion* add(const std::string& name, Image* image);
+
+    //  Bytes of texture memory used by all of the pages.
+    uint32_t getMemoryUsed() const {
+      return pages.size() * TextureAtlas::PAGE_SIZE * TextureAtlas::PAGE_SIZE * 4;
+    }
+
+    Texture* getPage(const uint32_t page) const {
+      if (page < pages.size()) {
+        return pages[page];
+      }
+
+      return nullptr;
+    }
+
+    uint32_t getPageCount() const {
+      return pages.size();
+    }
+
+    //  Regions stay where they are for as long as the atlas does.
+    const AtlasRegion* getRegion(const std::string& name) const;
+  private:
+    //  Images are surrounded by a copy of their edge pixels, so that
+    //  sampling right at the edge of a region never picks up a neighbour.
+    const static uint32_t BORDER = 1;
+
+    std::vector<Texture*> pages;
+    PagedShelfPacker packer;
+    std::map<std::string, AtlasRegion> regions;
+
+    TextureAtlas(const TextureAtlas&);
+    TextureAtlas& operator=(const TextureAtlas&);
+  };
+}
+
+#endif // TextureAtlasHPP
@@ -0,0 +1,39 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#ifndef TileInstanceHPP
+#define TileInstanceHPP
+
+#include <cmath>
+#include <cstdint>
+
+namespace io {
+  /**
+   * Where one tile of an instanced draw goes.  The layout matches the
+   * inInstance attribute of the vertex shader.
+   */
+  struct TileInstance {
+    TileInstance(const int32_t x, const int32_t y, const float angle)
+      : x(x * 16.0f), z(y * 16.0f), cosAngle(::cos(angle)), sinAngle(::sin(angle)) {
+    }
+
+    float x;
+    float z;
+    float cosAngle;
+    float sinAngle;
+  };
+}
+
+#endif // TileInstanceHPP
@@ -66,4 +66,53 @@ namespace io {
     
     return ret;
   }
+
+  /**
+   * @brief Decodes the UTF-8 code point starting at text[index].
+   * @returns The code point, or U+FFFD if the bytes there aren't valid UTF-8.
+   * index is moved on to the start of the next code point either way.
+   */
+  uint32_t decodeUTF8(const std::string& text, std::size_t& index) {
+    const uint32_t REPLACEMENT = 0xFFFD;
+    uint8_t lead = text[index++];
+    uint32_t codePoint;
+    uint32_t continuations;
+    uint32_t minimum;
+
+    if (lead < 0x80) {
+      return lead;
+    }
+    else if ((lead & 0xE0) == 0xC0) {
+      codePoint = lead & 0x1F;
+      continuations = 1;
+      minimum = 0x80;
+    }
+    else if ((lead & 0xF0) == 0xE0) {
+      codePoint = lead & 0x0F;
+      continuations = 2;
+      minimum = 0x800;
+    }
+    else if ((lead & 0xF8) == 0xF0) {
+      codePoint = lead & 0x07;
+      continuations = 3;
+      minimum = 0x10000;
+    }
+    else {
+      return REPLACEMENT;
+    }
+
+    for (uint32_t i = 0; i < continuations; i++) {
+      if (index >= text.size() || (text[index] & 0xC0) != 0x80) {
+        return REPLACEMENT;
+      }
+      codePoint = (codePoint << 6) | (text[index++] & 0x3F);
+    }
+
+    //  Overlong encodings, surrogates and anything past the end of Unicode.
+    if (codePoint < minimum || (codePoint >= 0xD800 && codePoint <= 0xDFFF) || codePoint > 0x10FFFF) {
+      return REPLACEMENT;
+    }
+
+    return codePoint;
+  }
 }
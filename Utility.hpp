@@ -18,6 +18,7 @@
 
 #include <cmath>
 #include <cstdint>
+#include <string>
 
 namespace io {
 #ifndef M_PI
@@ -62,6 +63,7 @@ namespace io {
   float toRadians(float degrees);
   float toDegrees(float radians);
   uint32_t minPowerOfTwo(const uint32_t in);
+  uint32_t decodeUTF8(const std::string& text, std::size_t& index);
 }
 
 #endif // UtilityHPP
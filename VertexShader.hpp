@@ -23,8 +23,8 @@
 namespace io {
   class VertexShader : public Shader {
   public:
-    VertexShader(const std::string& filename) : Shader() {
-      this->loadShaderFromFile(filename);
+    VertexShader(const std::string& filename, const std::string& preamble = std::string()) : Shader() {
+      this->loadShaderFromFile(filename, preamble);
     }
 
     virtual ~VertexShader() {
@@ -0,0 +1,47 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#include "ViewFrustum.hpp"
+
+namespace io {
+  ViewFrustum::ViewFrustum(const Matrix& m) {
+    //  Gribb/Hartmann plane extraction.  Each plane is the last row of the
+    //  matrix plus or minus one of the other rows.
+    for (uint32_t i = 0; i < 4; i++) {
+      planes[0][i] = m.get(3, i) + m.get(0, i);  //  Left
+      planes[1][i] = m.get(3, i) - m.get(0, i);  //  Right
+      planes[2][i] = m.get(3, i) + m.get(1, i);  //  Bottom
+      planes[3][i] = m.get(3, i) - m.get(1, i);  //  Top
+      planes[4][i] = m.get(3, i) + m.get(2, i);  //  Near
+      planes[5][i] = m.get(3, i) - m.get(2, i);  //  Far
+    }
+  }
+
+  bool ViewFrustum::containsBox(const Vector3& min, const Vector3& max) const {
+    for (uint32_t i = 0; i < ViewFrustum::PLANE_COUNT; i++) {
+      //  Test the corner of the box that lies furthest along the plane's
+      //  normal.  If even that is behind the plane, the whole box is.
+      float x = (planes[i][0] >= 0.0f) ? max.getX() : min.getX();
+      float y = (planes[i][1] >= 0.0f) ? max.getY() : min.getY();
+      float z = (planes[i][2] >= 0.0f) ? max.getZ() : min.getZ();
+
+      if ((planes[i][0] * x) + (planes[i][1] * y) + (planes[i][2] * z) + planes[i][3] < 0.0f) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+#ifndef ViewFrustumHPP
+#define ViewFrustumHPP
+
+#include "Matrix.hpp"
+#include "Vector3.hpp"
+
+namespace io {
+  /**
+   * The six clipping planes of a view volume, extracted from a combined
+   * projection * view matrix.  Used to throw away geometry that can't
+   * possibly end up on screen before it gets sent to OpenGL.
+   */
+  class ViewFrustum {
+  public:
+    ViewFrustum(const Matrix& viewProjection);
+
+    /**
+     * Returns false if the axis aligned box lies entirely outside of one of
+     * the planes.  Boxes that straddle a corner of the frustum may be
+     * reported as visible, which is fine for culling.
+     */
+    bool containsBox(const Vector3& min, const Vector3& max) const;
+  private:
+    const static uint32_t PLANE_COUNT = 6;
+
+    float planes[ViewFrustum::PLANE_COUNT][4];
+  };
+}
+
+#endif // ViewFrustumHPP
@@ -0,0 +1,223 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+/*
+ * Measures vertex throughput on a synthetic floor, open from wall to wall
+ * with walls around every cell, so that there's a lot of geometry and
+ * little to fill.  The same chunks are drawn with the vertex shader that
+ * multiplied the model, view and projection matrices per vertex, and with
+ * data/vertex.glsl, which takes them multiplied together per draw.
+ *
+ * Run from the source directory.
+ */
+#include "SDL.h"
+#include "Common.hpp"
+#include "FloorGeometry.hpp"
+#include "GLState.hpp"
+#include "Graphics.hpp"
+#include "Log.hpp"
+#include "ResourceManager.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace io;
+
+namespace {
+  const int32_t FLOOR_SIZE = 128;
+  const int32_t CHUNK_SIZE = 16;
+  const uint32_t FRAMES = 200;
+
+  //  The window is tiny, so that the vertices are the bottleneck.
+  const int32_t WINDOW_SIZE = 64;
+
+  //  data/vertex.glsl as it was, multiplying three matrices a vertex.
+  const char* THREE_MATRIX_SOURCE =
+    "uniform mat4 inModelMatrix;\n"
+    "uniform mat4 inViewMatrix;\n"
+    "uniform mat4 inProjectionMatrix;\n"
+    "attribute vec4 inVertex;\n"
+    "attribute vec2 inTexCoord;\n"
+    "attribute vec4 inColour;\n"
+    "attribute vec4 inInstance;\n"
+    "varying vec2 outTexCoord;\n"
+    "varying vec4 outColour;\n"
+    "void main() {\n"
+    "    vec4 placed = vec4((inVertex.x * inInstance.z) + (inVertex.z * inInstance.w) + inInstance.x,\n"
+    "                       inVertex.y,\n"
+    "                       (inVertex.z * inInstance.z) - (inVertex.x * inInstance.w) + inInstance.y,\n"
+    "                       inVertex.w);\n"
+    "    gl_Position = placed * inModelMatrix * inViewMatrix * inProjectionMatrix;\n"
+    "    outColour = inColour;\n"
+    "    outTexCoord = inTexCoord;\n"
+    "}\n";
+
+  ShaderProgram* createProgram(VertexShader* vertexShader, FragmentShader* fragmentShader) {
+    ShaderProgram* program = new ShaderProgram();
+    program->setVertexShader(vertexShader);
+    program->setFragmentShader(fragmentShader);
+    program->addBinding(0, "inVertex");
+    program->addBinding(1, "inTexCoord");
+    program->addBinding(2, "inColour");
+    program->addBinding(3, "inInstance");
+    program->link();
+    return program;
+  }
+
+  void deleteProgram(ShaderProgram* program) {
+    program->makeInactive();
+    program->unlink();
+    program->setVertexShader(nullptr);
+    program->setFragmentShader(nullptr);
+    delete program;
+  }
+
+  FloorGeometry* bakeChunk(Graphics* g, const int32_t chunkX, const int32_t chunkY) {
+    FloorGeometry* chunk = new FloorGeometry();
+    chunk->begin();
+
+    uint32_t cell = 0;
+    for (int32_t y = chunkY * CHUNK_SIZE; y < (chunkY + 1) * CHUNK_SIZE; y++) {
+      for (int32_t x = chunkX * CHUNK_SIZE; x < (chunkX + 1) * CHUNK_SIZE; x++) {
+        Matrix cellTransform = Matrix::translation(x * 16.0f, 0.0f, y * 16.0f);
+        chunk->beginCell(cell++);
+        chunk->addFloorTile(g->getFloorMesh(), cellTransform);
+        chunk->addCeilingTile(g->getCeilingMesh(), cellTransform);
+        for (Facing side : { Facing::NORTH, Facing::EAST, Facing::SOUTH, Facing::WEST }) {
+          chunk->addWallTile(g->getWallMesh(), cellTransform * Graphics::getWallTileRotation(side));
+        }
+        chunk->endCell();
+      }
+    }
+
+    chunk->end();
+    return chunk;
+  }
+
+  /**
+   * Draws every chunk once a frame.  Each chunk gets its own model matrix,
+   * as the map's chunks would if they moved, and the camera is set once a
+   * frame, as Graphics leaves it.
+   */
+  double timeFrames(const char* name, ShaderProgram* program, const bool composed, const std::vector<FloorGeometry*>& chunks, const uint32_t vertices) {
+    Matrix projection = Matrix::frustum(-(1 + ((3.0 / 4.0) / 2.0)), 1 + ((3.0 / 4.0) / 2.0), -1, 1, 1, 512);
+    Matrix view = Matrix::translation(FLOOR_SIZE * -8.0f, -8.0f, FLOOR_SIZE * -8.0f);
+    Matrix viewProjection = projection * view;
+
+    program->makeActive();
+    GLint modelUniform = program->getUniformLocation("inModelMatrix");
+    GLint viewUniform = program->getUniformLocation("inViewMatrix");
+    GLint projectionUniform = program->getUniformLocation("inProjectionMatrix");
+    GLint modelViewProjectionUniform = program->getUniformLocation("inModelViewProjectionMatrix");
+
+    //  One frame to warm up.
+    std::chrono::steady_clock::time_point start;
+    for (uint32_t frame = 0; frame <= FRAMES; frame++) {
+      if (frame == 1) {
+        glFinish();
+        start = std::chrono::steady_clock::now();
+      }
+
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      if (!composed) {
+        glUniformMatrix4fv(viewUniform, 1, GL_FALSE, view.getData());
+        glUniformMatrix4fv(projectionUniform, 1, GL_FALSE, projection.getData());
+      }
+
+      for (uint32_t i = 0; i < chunks.size(); i++) {
+        Matrix model = Matrix::translation(0.0f, (i % 2) * 0.01f, 0.0f);
+        if (composed) {
+          Matrix modelViewProjection = viewProjection * model;
+          glUniformMatrix4fv(modelViewProjectionUniform, 1, GL_FALSE, modelViewProjection.getData());
+        }
+        else {
+          glUniformMatrix4fv(modelUniform, 1, GL_FALSE, model.getData());
+        }
+
+        chunks[i]->draw();
+      }
+    }
+    glFinish();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double perFrame = (seconds * 1000.0) / FRAMES;
+    printf("%-24s %10.3f ms/frame %12.0f vertices/s\n", name, perFrame, (double)vertices * FRAMES / seconds);
+    return perFrame;
+  }
+}
+
+int main(int, char**) {
+  initLog();
+
+  if (SDL_Init(SDL_INIT_VIDEO) == -1) {
+    fprintf(stderr, "Could not initialize SDL.\n");
+    return 1;
+  }
+
+  SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 2);
+  SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 1);
+  SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+  SDL_Window* win = SDL_CreateWindow("FloorRenderBenchmark", SDL_WINDOWPOS_UNDEFINED,
+                                     SDL_WINDOWPOS_UNDEFINED, WINDOW_SIZE, WINDOW_SIZE,
+                                     SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+  SDL_GLContext context = SDL_GL_CreateContext(win);
+
+  //  For its meshes, and the vertex array the chunks are drawn through.
+  Graphics* graphics = new Graphics();
+  GLState::getInstance()->setDepthTest(true);
+
+  std::vector<FloorGeometry*> chunks;
+  for (int32_t y = 0; y < FLOOR_SIZE / CHUNK_SIZE; y++) {
+    for (int32_t x = 0; x < FLOOR_SIZE / CHUNK_SIZE; x++) {
+      chunks.push_back(bakeChunk(graphics, x, y));
+    }
+  }
+
+  uint32_t vertices = (graphics->getFloorMesh()->getVertexCount() + graphics->getCeilingMesh()->getVertexCount() +
+                       graphics->getWallMesh()->getVertexCount() * 4) * FLOOR_SIZE * FLOOR_SIZE;
+  printf("%u chunks, %u vertices a frame\n", (uint32_t)chunks.size(), vertices);
+
+  FragmentShader* fragmentShader = new FragmentShader("data/fragment.glsl", "#define TEXTURED\n");
+  VertexShader* threeMatrixShader = new VertexShader("data/vertex.glsl");
+  threeMatrixShader->loadShaderFromText(THREE_MATRIX_SOURCE);
+  VertexShader* composedShader = new VertexShader("data/vertex.glsl");
+
+  ShaderProgram* threeMatrixProgram = createProgram(threeMatrixShader, fragmentShader);
+  ShaderProgram* composedProgram = createProgram(composedShader, fragmentShader);
+
+  double before = timeFrames("three matrices a vertex", threeMatrixProgram, false, chunks, vertices);
+  double after = timeFrames("one matrix a vertex", composedProgram, true, chunks, vertices);
+  printf("speedup %.2fx\n", before / after);
+
+  deleteProgram(threeMatrixProgram);
+  deleteProgram(composedProgram);
+  delete threeMatrixShader;
+  delete composedShader;
+  delete fragmentShader;
+
+  for (FloorGeometry* chunk : chunks) {
+    delete chunk;
+  }
+
+  delete graphics;
+  ResourceManager::deleteInstance();
+  GLState::deleteInstance();
+  SDL_GL_DeleteContext(context);
+  SDL_DestroyWindow(win);
+  SDL_Quit();
+
+  return 0;
+}
@@ -0,0 +1,157 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+/*
+ * Measures text layout throughput.  The same strings are laid out by
+ * looking kerning up with FT_Get_Kerning() for every pair of characters, as
+ * Font used to, and by Font::getTextBoundingBox(), which uses the kerning
+ * tables built with each glyph set.
+ *
+ * Run from the source directory, or pass the path of a font.  Only the
+ * legacy 'kern' table is read, and the font shipped in data/ has none, so
+ * its numbers time the lookups without any kerning pairs.  Pass a font that
+ * has one (DejaVuSans.ttf, for instance) to measure real kerning.
+ */
+#include "SDL.h"
+#include "Common.hpp"
+#include "Font.hpp"
+#include "GLState.hpp"
+#include "Log.hpp"
+#include "ResourceManager.hpp"
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+using namespace io;
+
+namespace {
+  const uint32_t ITERATIONS = 200000;
+  const uint32_t PIXEL_SIZE = 12;
+
+  //  What the town menus and labels draw.
+  const std::vector<std::string> SAMPLES = {
+    "Guild Hall", "Create Character", "Delete Character", "Party Organization",
+    "Leave", "Enter the Maze", "AVAST Ye WAVY Tomes", "Name:  Quixotic Knight"
+  };
+
+  float layoutWithFreeType(FT_Face face, const FT_UInt* indices, const float* advances, const std::string& text) {
+    float w = 0.0f;
+    uint8_t previous = 0;
+    for (uint8_t c : text) {
+      if (previous != 0) {
+        FT_Vector delta;
+        FT_Get_Kerning(face, indices[previous], indices[c], FT_KERNING_DEFAULT, &delta);
+        w += delta.x >> 6;
+      }
+
+      w += advances[c];
+      previous = c;
+    }
+
+    return w;
+  }
+
+  double report(const char* name, std::chrono::steady_clock::duration elapsed, uint32_t characters) {
+    double seconds = std::chrono::duration<double>(elapsed).count();
+    double perString = (seconds * 1e9) / (ITERATIONS * SAMPLES.size());
+    printf("%-24s %10.1f ns/string %12.0f chars/s\n", name, perString, characters / seconds);
+    return perString;
+  }
+}
+
+int main(int argc, char** argv) {
+  initLog();
+  std::string fontFile = (argc > 1) ? argv[1] : "data/DejaVuSansMono.ttf";
+
+  //  Glyph sets are uploaded as textures, so a context is needed.
+  if (SDL_Init(SDL_INIT_VIDEO) == -1) {
+    fprintf(stderr, "Could not initialize SDL.\n");
+    return 1;
+  }
+
+  SDL_Window* win = SDL_CreateWindow("FontLayoutBenchmark", SDL_WINDOWPOS_UNDEFINED,
+                                     SDL_WINDOWPOS_UNDEFINED, 64, 64,
+                                     SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+  SDL_GLContext context = SDL_GL_CreateContext(win);
+  glewExperimental = GL_TRUE;
+  glewInit();
+
+  //  The old layout worked on bitmap glyphs at the size being laid out.
+  ResourceManager::getInstance()->setFontRenderMode(FontRenderMode::BITMAP);
+  Resource* resource = ResourceManager::getInstance()->getResource(fontFile);
+  Font* font = resource ? resource->toFont() : nullptr;
+  if (!font) {
+    fprintf(stderr, "Could not load \"%s\".\n", fontFile.c_str());
+    return 1;
+  }
+  font->setPixelSize(PIXEL_SIZE);
+
+  FT_Library library;
+  FT_Face face;
+  FT_Init_FreeType(&library);
+  FT_New_Face(library, fontFile.c_str(), 0, &face);
+  FT_Set_Char_Size(face, 0, PIXEL_SIZE << 6, 96, 96);
+  if (!FT_HAS_KERNING(face)) {
+    fprintf(stderr, "Warning: \"%s\" has no kerning table; no pairs will be kerned.\n", fontFile.c_str());
+  }
+
+  FT_UInt indices[256];
+  float advances[256];
+  for (uint32_t i = 0; i < 256; i++) {
+    indices[i] = FT_Get_Char_Index(face, i);
+    FT_Load_Char(face, i, FT_LOAD_DEFAULT);
+    advances[i] = face->glyph->metrics.horiAdvance >> 6;
+  }
+
+  uint32_t characters = 0;
+  for (const std::string& sample : SAMPLES) {
+    characters += sample.size();
+  }
+  characters *= ITERATIONS;
+
+  //  Summed so the work can't be thrown away.
+  float sink = 0.0f;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    for (const std::string& sample : SAMPLES) {
+      sink += layoutWithFreeType(face, indices, advances, sample);
+    }
+  }
+  double before = report("FT_Get_Kerning per pair", std::chrono::steady_clock::now() - start, characters);
+
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    for (const std::string& sample : SAMPLES) {
+      sink += font->getTextBoundingBox(sample).w;
+    }
+  }
+  double after = report("Font kerning table", std::chrono::steady_clock::now() - start, characters);
+
+  printf("speedup %.2fx (%f)\n", before / after, sink);
+
+  FT_Done_Face(face);
+  FT_Done_FreeType(library);
+  ResourceManager::deleteInstance();
+  GLState::deleteInstance();
+  SDL_GL_DeleteContext(context);
+  SDL_DestroyWindow(win);
+  SDL_Quit();
+
+  return 0;
+}
@@ -0,0 +1,233 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+/*
+ * Measures Matrix against the implementation it replaced, which is copied
+ * in below.  The old one built every matrix with set() and multiplied with
+ * a triple loop through get() and set().  Here its get() and set() can be
+ * inlined, which they couldn't be from Matrix.cpp, so if anything it looks
+ * better than it was.
+ *
+ * The old transpose() copied the matrix without transposing it, so the
+ * copy below is fixed to do what was meant.
+ */
+#include "Graphics.hpp"
+#include "Matrix.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+using namespace io;
+
+namespace {
+  const uint32_t ITERATIONS = 5000000;
+
+  class LegacyMatrix {
+  public:
+    LegacyMatrix() {
+      for (uint32_t row = 0; row < 4; row++) {
+        for (uint32_t column = 0; column < 4; column++) {
+          set(row, column, 0.0f);
+        }
+      }
+    }
+
+    LegacyMatrix(const float m11, const float m12, const float m13, const float m14,
+                 const float m21, const float m22, const float m23, const float m24,
+                 const float m31, const float m32, const float m33, const float m34,
+                 const float m41, const float m42, const float m43, const float m44) {
+      set(0, 0, m11); set(0, 1, m12); set(0, 2, m13); set(0, 3, m14);
+      set(1, 0, m21); set(1, 1, m22); set(1, 2, m23); set(1, 3, m24);
+      set(2, 0, m31); set(2, 1, m32); set(2, 2, m33); set(2, 3, m34);
+      set(3, 0, m41); set(3, 1, m42); set(3, 2, m43); set(3, 3, m44);
+    }
+
+    LegacyMatrix operator*(const LegacyMatrix& rhs) const {
+      LegacyMatrix out;
+
+      for (uint32_t row = 0; row < 4; row++) {
+        for (uint32_t column = 0; column < 4; column++) {
+          float sum = 0.0;
+
+          for (uint32_t i = 0; i < 4; i++) {
+            sum += this->get(row, i) * rhs.get(i, column);
+          }
+
+          out.set(row, column, sum);
+        }
+      }
+
+      return out;
+    }
+
+    float get(const uint32_t row, const uint32_t column) const {
+      if (row >= 4 || column >= 4) {
+        return 0.0f;
+      }
+
+      return this->matrix[row][column];
+    }
+
+    void set(const uint32_t row, const uint32_t column, const float in) {
+      if (row >= 4 || column >= 4) {
+        return;
+      }
+
+      this->matrix[row][column] = in;
+    }
+
+    static LegacyMatrix identity() {
+      return LegacyMatrix(1.0f, 0.0f, 0.0f, 0.0f,
+                          0.0f, 1.0f, 0.0f, 0.0f,
+                          0.0f, 0.0f, 1.0f, 0.0f,
+                          0.0f, 0.0f, 0.0f, 1.0f);
+    }
+
+    static LegacyMatrix rotation(const float angle, const float x, const float y, const float z) {
+      float s = ::sin(angle);
+      float c = ::cos(angle);
+      float c1 = 1 - c;
+
+      return LegacyMatrix(((x * x) * c1) + c, ((x * y) * c1) - (z * s), ((x * z) * c1) + (y * s), 0,
+                          ((y * x) * c1) + (z * s), ((y * y) * c1) + c, ((y * z) * c1) - (x * s), 0,
+                          ((x * z) * c1) - (y * s), ((y * z) * c1) + (x * s), ((z * z) * c1) + c, 0,
+                          0, 0, 0, 1);
+    }
+
+    static LegacyMatrix translation(const float x, const float y, const float z) {
+      return LegacyMatrix(1.0f, 0.0f, 0.0f,    x,
+                          0.0f, 1.0f, 0.0f,    y,
+                          0.0f, 0.0f, 1.0f,    z,
+                          0.0f, 0.0f, 0.0f, 1.0f);
+    }
+
+    LegacyMatrix transpose() const {
+      LegacyMatrix out;
+
+      for (uint32_t y = 0; y < 4; y++) {
+        for (uint32_t x = 0; x < 4; x++) {
+          out.set(x, y, this->get(y, x));
+        }
+      }
+
+      return out;
+    }
+  private:
+    float matrix[4][4];
+  };
+
+  double report(const char* name, std::chrono::steady_clock::duration elapsed) {
+    double nanoseconds = std::chrono::duration<double, std::nano>(elapsed).count() / ITERATIONS;
+    printf("%-32s %8.2f ns/op\n", name, nanoseconds);
+    return nanoseconds;
+  }
+
+  void compare(const char* name, const double before, const double after) {
+    printf("%-32s %8.2fx\n", name, before / after);
+  }
+}
+
+int main(int, char**) {
+  //  Rotations keep the products from running off to infinity.
+  const float angle = 0.001f;
+
+  //  Summed so the work can't be thrown away.
+  float sink = 0.0f;
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  LegacyMatrix legacyProduct = LegacyMatrix::identity();
+  LegacyMatrix legacyStep = LegacyMatrix::rotation(angle, 0.6f, 0.8f, 0.0f);
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    legacyProduct = legacyProduct * legacyStep;
+  }
+  sink += legacyProduct.get(0, 0);
+  double legacyMultiply = report("legacy multiply", std::chrono::steady_clock::now() - start);
+
+  start = std::chrono::steady_clock::now();
+  Matrix product = Matrix::identity();
+  Matrix step = Matrix::rotation(angle, 0.6f, 0.8f, 0.0f);
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    product = product * step;
+  }
+  sink += product.get(0, 0);
+  double multiply = report("multiply", std::chrono::steady_clock::now() - start);
+
+  //  What drawWallTile() does: a translation, then a turn about y.
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    Facing side = static_cast<Facing>(i % 4);
+    LegacyMatrix wall = LegacyMatrix::identity() * LegacyMatrix::translation((i % 64) * 16.0f, 0.0f, (i / 64 % 64) * 16.0f);
+    wall = wall * LegacyMatrix::rotation(Graphics::getWallTileAngle(side), 0.0f, 1.0f, 0.0f);
+    sink += wall.get(0, 3);
+  }
+  double legacyWall = report("legacy wall transform", std::chrono::steady_clock::now() - start);
+
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    Facing side = static_cast<Facing>(i % 4);
+    Matrix wall = Matrix::identity().translated((i % 64) * 16.0f, 0.0f, (i / 64 % 64) * 16.0f);
+    wall = wall * Graphics::getWallTileRotation(side);
+    sink += wall.get(0, 3);
+  }
+  double wall = report("wall transform", std::chrono::steady_clock::now() - start);
+
+  //  The same, for turns that aren't right angles.
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    Matrix turned = Matrix::identity().translated(1.0f, 2.0f, 3.0f).rotatedY(::cos(i * angle), ::sin(i * angle));
+    sink += turned.get(0, 0);
+  }
+  report("translated, rotatedY", std::chrono::steady_clock::now() - start);
+
+  start = std::chrono::steady_clock::now();
+  LegacyMatrix legacyTransposed = legacyStep;
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    legacyTransposed = legacyTransposed.transpose();
+  }
+  sink += legacyTransposed.get(0, 1);
+  double legacyTranspose = report("legacy transpose", std::chrono::steady_clock::now() - start);
+
+  start = std::chrono::steady_clock::now();
+  Matrix transposed = step;
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    transposed = transposed.transpose();
+  }
+  sink += transposed.get(0, 1);
+  double transpose = report("transpose", std::chrono::steady_clock::now() - start);
+
+  //  The old matrix had no inverse to compare with.
+  Matrix view = Matrix::translation(1.0f, 2.0f, 3.0f) * step;
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    view = view.inverse();
+  }
+  sink += view.get(0, 3);
+  double inverse = report("inverse", std::chrono::steady_clock::now() - start);
+
+  start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < ITERATIONS; i++) {
+    view = view.affineInverse();
+  }
+  sink += view.get(0, 3);
+  double affineInverse = report("affineInverse", std::chrono::steady_clock::now() - start);
+
+  compare("multiply speedup", legacyMultiply, multiply);
+  compare("wall transform speedup", legacyWall, wall);
+  compare("transpose speedup", legacyTranspose, transpose);
+  compare("affineInverse over inverse", inverse, affineInverse);
+  printf("(%f)\n", sink);
+
+  return 0;
+}
@@ -0,0 +1,26 @@
+uniform sampler2D inTexture;
+uniform float inSampleMode;
+
+varying vec2 outTexCoord;
+varying vec4 outColour;
+
+void main() {
+	//  outColour is premultiplied, so everything here comes out premultiplied
+	//  too.  inSampleMode is 0 for images, 1 for glyph coverage, 2 for
+	//  distance field glyphs and 3 for premultiplied images, as SampleMode
+	//  numbers them.
+	vec4 texel = texture2D(inTexture, outTexCoord.st);
+	if (inSampleMode < 0.5) {
+		gl_FragColor = vec4(texel.rgb * texel.a, texel.a) * outColour;
+	}
+	else if (inSampleMode < 1.5) {
+		gl_FragColor = outColour * texel.r;
+	}
+	else if (inSampleMode > 2.5) {
+		gl_FragColor = texel * outColour;
+	}
+	else {
+		float width = fwidth(texel.r) * 0.75;
+		gl_FragColor = outColour * smoothstep(0.5 - width, 0.5 + width, texel.r);
+	}
+}
@@ -1,8 +1,56 @@
-uniform sampler2D inTexture;
-
-varying vec2 outTexCoord;
-varying vec4 outColour;
-
-void main() {
-	gl_FragColor = mix(outColour, texture2D(inTexture, outTexCoord.st), 1.0);
-}
+//  Built once per set of features, see ShaderVariants.  The generic variant
+//  has them all, and picks between them with inFeatures at run time.
+uniform sampler2D inTexture;
+
+varying vec2 outTexCoord;
+varying vec4 outColour;
+
+#ifdef GENERIC
+//  (textured, vertex coloured, alpha tested, distance field), each 0 or 1.
+uniform vec4 inFeatures;
+#endif
+
+void main() {
+	vec4 colour = vec4(1.0, 1.0, 1.0, 1.0);
+
+#if defined(GENERIC)
+	vec4 texel = texture2D(inTexture, outTexCoord.st);
+	if (inFeatures.w > 0.5) {
+		float width = fwidth(texel.r) * 0.75;
+		colour = vec4(smoothstep(0.5 - width, 0.5 + width, texel.r));
+	}
+	else if (inFeatures.x > 0.5) {
+		colour = texel;
+	}
+
+	if (inFeatures.y > 0.5) {
+		colour *= outColour;
+	}
+
+	if (inFeatures.z > 0.5 && colour.a < 0.5) {
+		discard;
+	}
+#else
+#if defined(DISTANCE_FIELD)
+	//  The texture holds the distance to the glyph's outline, which sits at
+	//  0.5.  fwidth() keeps the edge about a pixel wide at any scale.
+	float distance = texture2D(inTexture, outTexCoord.st).r;
+	float width = fwidth(distance) * 0.75;
+	colour = vec4(smoothstep(0.5 - width, 0.5 + width, distance));
+#elif defined(TEXTURED)
+	colour = texture2D(inTexture, outTexCoord.st);
+#endif
+
+#ifdef VERTEX_COLOUR
+	colour *= outColour;
+#endif
+
+#ifdef ALPHA_TEST
+	if (colour.a < 0.5) {
+		discard;
+	}
+#endif
+#endif
+
+	gl_FragColor = colour;
+}
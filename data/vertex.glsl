@@ -1,15 +1,27 @@
+//  Vertices only need the three matrices multiplied together, which
+//  Graphics does once per draw.  The separate matrices are here for
+//  shaders that light in view or world space.  They're only uploaded to
+//  programs that read them, see Graphics::applyMatrices().
 uniform mat4 inViewMatrix;
-uniform mat4 inModelMatrix;
 uniform mat4 inProjectionMatrix;
+uniform mat4 inModelMatrix;
+uniform mat4 inModelViewProjectionMatrix;
 
 attribute vec4 inVertex;
 attribute vec2 inTexCoord;
 attribute vec4 inColour;
+attribute vec4 inInstance;
 varying vec2 outTexCoord;
 varying vec4 outColour;
 
 void main() {
-    gl_Position = inVertex * inModelMatrix * inViewMatrix * inProjectionMatrix;
+    //  inInstance is (x, z, cos, sin) of a tile's placement, turning about
+    //  the y axis.  Outside of instanced draws it's held at (0, 0, 1, 0).
+    vec4 placed = vec4((inVertex.x * inInstance.z) + (inVertex.z * inInstance.w) + inInstance.x,
+                       inVertex.y,
+                       (inVertex.z * inInstance.z) - (inVertex.x * inInstance.w) + inInstance.y,
+                       inVertex.w);
+    gl_Position = placed * inModelViewProjectionMatrix;
     outColour = inColour;
     outTexCoord = inTexCoord;
 }
@@ -15,6 +15,7 @@
 */
 #include "SDL.h"
 #include "Common.hpp"
+#include "GLState.hpp"
 #include "Graphics.hpp"
 #include "Utility.hpp"
 #include <iostream>
@@ -24,10 +25,11 @@
 #include "ResourceManager.hpp"
 #include "Resource.hpp"
 #include "InputTranslator.hpp"
+#include <cstring>
 
 using namespace io;
 
-int main(int, char**) {
+int main(int argc, char** argv) {
   initLog();
   
   if (SDL_Init(SDL_INIT_VIDEO) == -1) {
@@ -51,10 +53,41 @@ int main(int, char**) {
 
   SDL_GLContext context = SDL_GL_CreateContext(win);
 
-  glEnable(GL_DEPTH_TEST);
   glEnable(GL_TEXTURE_2D);
 
+  //  Fonts are loaded along with Graphics, so this has to be known first.
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--distance-field-fonts") == 0) {
+      ResourceManager::getInstance()->setFontRenderMode(FontRenderMode::DISTANCE_FIELD);
+    }
+  }
+
   Graphics* graphics = new Graphics();
+  GLState::getInstance()->setDepthTest(true);
+
+  //  Render targets put these back from GLState once they're done, so it
+  //  has to know them.
+  GLState::getInstance()->bindFramebuffer(0);
+  GLState::getInstance()->setViewport(0, 0, 640, 480);
+  GLState::getInstance()->setClearColour(0.0f, 0.0f, 0.0f, 0.0f);
+
+  //  Draws the maze one tile at a time, or one kind of tile at a time,
+  //  instead of using the baked floor geometry.  Useful for comparing them,
+  //  along with the statistics overlay and CSV log.
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--per-tile") == 0) {
+      graphics->setMapRenderMode(MapRenderMode::PER_TILE);
+    }
+    else if (strcmp(argv[i], "--instanced") == 0) {
+      graphics->setMapRenderMode(MapRenderMode::INSTANCED);
+    }
+    else if (strcmp(argv[i], "--stats") == 0) {
+      graphics->setStatisticsOverlayEnabled(true);
+    }
+    else if (strcmp(argv[i], "--stats-csv") == 0 && i + 1 < argc) {
+      graphics->setStatisticsLog(argv[++i]);
+    }
+  }
   Game* game = new Game();
   
   Resource* checker = ResourceManager::getInstance()->getResource("data/checker.png");
@@ -110,10 +143,12 @@ int main(int, char**) {
       dltTime -= 1000;
     }
 
+    graphics->beginFrame();
     graphics->setMatrixMode(MatrixMode::MODEL);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    basicTex->makeActive();
+    graphics->setTexture(basicTex);
     game->draw(graphics);
+    graphics->endFrame();
     
     /*
     graphics->setMatrixMode(MatrixMode::VIEW);
@@ -140,7 +175,11 @@ int main(int, char**) {
     SDL_GL_SwapWindow(win);
   }
 
+  //  Everything that gives GL names back through GLState goes first.
   delete game;
+  delete graphics;
+  ResourceManager::deleteInstance();
+  GLState::deleteInstance();
 
   return 0;
 }
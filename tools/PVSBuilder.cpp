@@ -0,0 +1,82 @@
+/*
+ * Copyright 2013 Cepheid
+ *
+ *  Licensed under the Apache License, Version 2.0 (the "License");
+ *  you may not use this file except in compliance with the License.
+ *  You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ *  Unless required by applicable law or agreed to in writing, software
+ *  distributed under the License is distributed on an "AS IS" BASIS,
+ *  WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ *  See the License for the specific language governing permissions and
+ *  limitations under the License.
+*/
+/*
+ * Builds the potentially visible set of each floor file given, and saves it
+ * next to the floor, where Map::mapFromXML() picks it up.  Floors without
+ * an up to date set cast rays whenever the player moves, so this wants
+ * running again whenever a floor's layout changes.
+ *
+ * Run from the source directory:  PVSBuilder data/floors/floor1.xml ...
+ */
+#include "Log.hpp"
+#include "Map.hpp"
+#include "PotentiallyVisibleSet.hpp"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+using namespace io;
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage:  %s [--force] floor.xml...\n", argv[0]);
+    return 1;
+  }
+
+  initLog();
+
+  //  Floors whose saved set still matches are skipped, unless asked not to.
+  bool force = false;
+  int result = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--force") == 0) {
+      force = true;
+      continue;
+    }
+
+    Map* map = Map::mapFromXML(argv[i]);
+    if (!map) {
+      fprintf(stderr, "Could not load floor \"%s\".\n", argv[i]);
+      result = 1;
+      continue;
+    }
+
+    std::string filename = Map::getPotentiallyVisibleSetFilename(argv[i]);
+    if (map->getPotentiallyVisibleSet() && !force) {
+      printf("%-32s up to date\n", filename.c_str());
+      delete map;
+      continue;
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    PotentiallyVisibleSet* pvs = PotentiallyVisibleSet::build(map);
+    std::chrono::milliseconds elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+    if (pvs->save(filename)) {
+      printf("%-32s %dx%d in %lldms, %u bytes\n", filename.c_str(), map->getWidth(), map->getHeight(), (long long)elapsed.count(), pvs->getEncodedSize());
+    }
+    else {
+      fprintf(stderr, "Could not save \"%s\".\n", filename.c_str());
+      result = 1;
+    }
+
+    delete pvs;
+    delete map;
+  }
+
+  return result;
+}